@@ -40,15 +40,19 @@ int main()
 		onion::EventHandle eventHandle_2 =
 			event.Subscribe([&example](const ExampleEventArgs& args) { example.sayEventValue(args); });
 
+		// Subscribe the member function directly: only the instance pointer is stored, no lambda needed
+		onion::EventHandle eventHandle_3 = event.Subscribe<&ExampleClass::sayEventValue>(example);
+
 		// Trigger the event with some arguments
 		std::cout << "\nTriggering event with value 100..." << std::endl;
 		event.Trigger(ExampleEventArgs(100));
 
-		// Unsubscribe the first handle
+		// Unsubscribe the first and third handles
 		event.Unsubscribe(eventHandle_1);
+		event.Unsubscribe(eventHandle_3);
 
 		// Trigger the event again to show that the first handle has been unsubscribed
-		std::cout << "\nTriggering event with value 150 after unsubscribing first handle..." << std::endl;
+		std::cout << "\nTriggering event with value 150 after unsubscribing first and third handles..." << std::endl;
 		event.Trigger(ExampleEventArgs(150));
 
 	} // The eventHandle goes out of scope here, automatically unsubscribing the handle
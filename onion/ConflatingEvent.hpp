@@ -0,0 +1,203 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <onion/Event.hpp>
+#include <onion/KeyTable.hpp>
+#include <onion/MpscQueue.hpp>
+
+namespace onion
+{
+	/// @brief Event delivered through a queue that keeps only the latest arguments posted for each key: posting for a key that is
+	/// already pending overwrites its arguments in place, keeping its position in the queue. The queue therefore never holds more
+	/// entries than there are distinct keys, however fast events are posted, and a slow consumer only sees the latest state.
+	/// Use the ConflatingEvent alias rather than this class directly.
+	/// @tparam ThreadingPolicy How writers are serialized and how the handlers list is published: MultiThreaded, SpinLocked or SingleThreaded.
+	/// @tparam HandlerCapacity The size, in bytes, of the inline storage of each handler.
+	/// @tparam Key The conflation key, e.g. an instrument identifier. Must be default constructible, copyable, equality comparable
+	/// and hashable with std::hash.
+	/// @tparam Args The types of the arguments passed to handlers when the event is delivered.
+	template <typename ThreadingPolicy, std::size_t HandlerCapacity, typename Key, typename... Args> class BasicConflatingEvent
+	{
+	  public:
+		/// @brief Event invoking the handlers when a pending entry is pumped.
+		using DeliveredEvent = BasicEvent<ThreadingPolicy, HandlerCapacity, Args...>;
+
+	  public:
+		BasicConflatingEvent() = default;
+		BasicConflatingEvent(const BasicConflatingEvent&) = delete;
+		BasicConflatingEvent& operator=(const BasicConflatingEvent&) = delete;
+
+		/// @brief Subscribes a handler to the delivered events.
+		/// @param handler The handler function to be invoked when a pending entry is pumped.
+		/// @param priority The priority of the handler. Handlers of a higher priority are invoked first.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle.
+		template <typename Callable>
+			requires std::is_invocable_v<std::decay_t<Callable>&, detail::EventParameter<Args>...>
+		[[nodiscard]] EventHandle Subscribe(Callable&& handler, int priority = 0)
+		{
+			return m_event.Subscribe(std::forward<Callable>(handler), priority);
+		}
+
+		/// @brief Subscribes a member function of an object to the delivered events. The object must outlive the subscription.
+		/// @tparam Method The member function to invoke, e.g. &MyClass::OnEvent.
+		/// @param instance The object on which the member function is invoked.
+		/// @param priority The priority of the handler. Handlers of a higher priority are invoked first.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle.
+		template <auto Method, typename Class>
+			requires std::is_member_function_pointer_v<decltype(Method)> &&
+					 std::is_invocable_v<decltype(Method), Class&, detail::EventParameter<Args>...>
+		[[nodiscard]] EventHandle Subscribe(Class& instance, int priority = 0)
+		{
+			return m_event.template Subscribe<Method>(instance, priority);
+		}
+
+		/// @brief Unsubscribes a handle from the event. Destroying the last copy of the handle has the same effect.
+		/// @param eventHandle The EventHandle representing the subscription to be removed.
+		void Unsubscribe(const EventHandle& eventHandle) { m_event.Unsubscribe(eventHandle); }
+
+		/// @brief Makes the given arguments the pending event of a key and returns immediately. If the key is already pending, its
+		/// arguments are overwritten in place and it keeps its position in the queue; otherwise it is queued behind the pending keys.
+		/// Safe to call from any thread with the concurrent policies. Only takes the writers mutex the first time a key is posted.
+		/// @param key The conflation key.
+		/// @param args The event arguments, copied into the entry of the key.
+		void Post(const Key& key, detail::EventParameter<Args>... args)
+		{
+			PendingEntry& entry = FindOrAdd(key);
+			{
+				std::lock_guard<EntryMutex> lock(entry.mutex);
+				if (entry.event)
+				{
+					*entry.event = std::forward_as_tuple(args...);
+				}
+				else
+				{
+					entry.event.emplace(args...);
+				}
+				if (std::exchange(entry.queued, true))
+				{
+					return;
+				}
+			}
+
+			m_pendingCount.fetch_add(1, std::memory_order_relaxed);
+			try
+			{
+				m_queue.Push(&entry);
+			}
+			catch (...)
+			{
+				m_pendingCount.fetch_sub(1, std::memory_order_relaxed);
+				std::lock_guard<EntryMutex> lock(entry.mutex);
+				entry.queued = false;
+				throw;
+			}
+		}
+
+		/// @brief Delivers the pending events on the calling thread, in the order their keys became pending. Must not be called from
+		/// several threads at once. A key posted again while pumping is delivered again, after the keys already pending.
+		/// @param maxCount The maximum number of events to deliver.
+		/// @return The number of delivered events.
+		std::size_t Pump(std::size_t maxCount = std::numeric_limits<std::size_t>::max())
+		{
+			std::size_t delivered = 0;
+			while (delivered < maxCount)
+			{
+				std::optional<PendingEntry*> entry = m_queue.TryPop();
+				if (!entry)
+				{
+					break;
+				}
+				m_pendingCount.fetch_sub(1, std::memory_order_relaxed);
+
+				// The entry keeps its storage, so the next post of the key assigns into it
+				std::optional<PendingEvent> event;
+				{
+					std::lock_guard<EntryMutex> lock((*entry)->mutex);
+					event.emplace(std::move(*(*entry)->event));
+					(*entry)->queued = false;
+				}
+				++delivered;
+				std::apply([this](const auto&... args) { m_event.Trigger(args...); }, *event);
+			}
+			return delivered;
+		}
+
+		/// @brief Returns the number of keys waiting to be pumped. Never more than the number of distinct keys posted.
+		std::size_t PendingCount() const noexcept { return m_pendingCount.load(std::memory_order_relaxed); }
+
+		/// @brief Clears the handlers, effectively unsubscribing all subscribers. Pending events are kept.
+		void Clear() { m_event.Clear(); }
+
+	  private:
+		using Mutex = typename ThreadingPolicy::Mutex;
+
+		/// @brief Lock of a single entry, held while its arguments are copied.
+		using EntryMutex = std::conditional_t<ThreadingPolicy::IsConcurrent, SpinMutex, NullMutex>;
+
+		/// @brief Arguments of a pending event.
+		using PendingEvent = std::tuple<std::decay_t<Args>...>;
+
+		/// @brief Latest arguments posted for a key. Entries are never destroyed before the conflating event, and are in the queue
+		/// at most once, while queued is true.
+		struct PendingEntry
+		{
+			EntryMutex mutex;
+
+			/// @brief True while the entry is in the queue. Guarded by the entry mutex.
+			bool queued = false;
+
+			/// @brief Latest arguments, empty until the key is first posted. Guarded by the entry mutex.
+			std::optional<PendingEvent> event;
+		};
+
+		/// @brief Keys posted so far and their entry.
+		using KeyIndex = detail::KeyIndex<Key, PendingEntry, ThreadingPolicy::IsConcurrent>;
+
+		/// @brief Returns the entry of a key, creating it if needed. Lock-free once the key was posted.
+		PendingEntry& FindOrAdd(const Key& key)
+		{
+			const std::size_t hash = detail::HashKey(key);
+			{
+				const detail::ReadGuard<ThreadingPolicy::IsConcurrent> guard;
+				if (PendingEntry* entry = m_keys.Find(key, hash))
+				{
+					return *entry;
+				}
+			}
+
+			// A replaced table is released once the mutex is unlocked
+			detail::Retired<typename KeyIndex::Table> previous;
+			std::lock_guard<Mutex> lock(m_mutex);
+			return m_keys.FindOrAdd(key, hash, previous);
+		}
+
+	  private:
+		/// @brief Event invoking the handlers.
+		DeliveredEvent m_event;
+
+		/// @brief Serializes the writers of the key index.
+		Mutex m_mutex;
+
+		/// @brief Entry of each key posted so far. Post looks keys up under an EpochGuard, without the mutex.
+		KeyIndex m_keys;
+
+		/// @brief Pending entries, in the order their key became pending.
+		detail::MpscQueue<PendingEntry*> m_queue;
+
+		/// @brief Number of entries in the queue.
+		std::atomic<std::size_t> m_pendingCount{0};
+	};
+
+	/// @brief Conflating event usable from any thread. Posting never takes the writers mutex once a key is known.
+	/// Use BasicConflatingEvent directly to choose another threading policy or handler capacity.
+	template <typename Key, typename... Args>
+	using ConflatingEvent = BasicConflatingEvent<MultiThreaded, DefaultInlineFunctionCapacity, Key, Args...>;
+} // namespace onion
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <onion/MpscQueue.hpp>
+
+namespace onion
+{
+	namespace detail
+	{
+		/// @brief Work queued on a Dispatcher.
+		class DispatchedCall
+		{
+		  public:
+			virtual ~DispatchedCall() = default;
+			virtual void Run() = 0;
+		};
+
+		template <typename Callable> class DispatchedCallable final : public DispatchedCall
+		{
+		  public:
+			template <typename Value> explicit DispatchedCallable(Value&& callable) : m_callable(std::forward<Value>(callable)) {}
+
+			void Run() override { m_callable(); }
+
+		  private:
+			Callable m_callable;
+		};
+	} // namespace detail
+
+	/// @brief Execution context of a thread, such as a UI or game loop: work posted to it from any thread runs on its owner thread,
+	/// when that thread calls Pump. Events deliver the handlers subscribed with a dispatcher through it, unless they are triggered
+	/// on its owner thread. Posting is lock-free.
+	class Dispatcher
+	{
+	  public:
+		/// @brief Creates a dispatcher owned by the calling thread.
+		Dispatcher() noexcept : m_owner(std::this_thread::get_id()) {}
+		Dispatcher(const Dispatcher&) = delete;
+		Dispatcher& operator=(const Dispatcher&) = delete;
+
+		/// @brief Drops the work that was not pumped. Handlers subscribed with the dispatcher must be unsubscribed before.
+		~Dispatcher() = default;
+
+		/// @brief Makes the calling thread the owner of the dispatcher, e.g. when it is created before the thread it serves.
+		void BindToCurrentThread() noexcept { m_owner.store(std::this_thread::get_id(), std::memory_order_release); }
+
+		/// @brief Returns true if the calling thread is the owner of the dispatcher.
+		bool IsCurrent() const noexcept { return m_owner.load(std::memory_order_acquire) == std::this_thread::get_id(); }
+
+		/// @brief Queues work for the owner thread and returns immediately. Safe to call from any thread.
+		/// @param work The callable to invoke, with no argument, from Pump.
+		template <typename Callable>
+			requires std::is_invocable_v<std::decay_t<Callable>&>
+		void Post(Callable&& work)
+		{
+			m_calls.Push(std::make_unique<detail::DispatchedCallable<std::decay_t<Callable>>>(std::forward<Callable>(work)));
+		}
+
+		/// @brief Runs the queued work on the calling thread, in the order it was posted. Must be called by the owner thread.
+		/// Work posted while pumping runs in the same call, within the limit.
+		/// @param maxCount The maximum number of calls to run.
+		/// @return The number of calls run.
+		std::size_t Pump(std::size_t maxCount = std::numeric_limits<std::size_t>::max())
+		{
+			std::size_t ran = 0;
+			while (ran < maxCount)
+			{
+				std::optional<std::unique_ptr<detail::DispatchedCall>> call = m_calls.TryPop();
+				if (!call)
+				{
+					break;
+				}
+				++ran;
+				(*call)->Run();
+			}
+			return ran;
+		}
+
+	  private:
+		/// @brief Thread running the queued work, and on which handlers are invoked inline.
+		std::atomic<std::thread::id> m_owner;
+
+		/// @brief Work waiting for Pump.
+		detail::MpscQueue<std::unique_ptr<detail::DispatchedCall>> m_calls;
+	};
+} // namespace onion
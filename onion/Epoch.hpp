@@ -0,0 +1,348 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <onion/ThreadingPolicy.hpp>
+
+namespace onion
+{
+	namespace detail
+	{
+		/// @brief Base of the objects published to lock-free readers, such as handlers lists and key tables. Once replaced, such an
+		/// object is retired to the epoch domain, which destroys it when no reader can still be using it.
+		class Reclaimable
+		{
+		  public:
+			Reclaimable() = default;
+			Reclaimable(const Reclaimable&) = delete;
+			Reclaimable& operator=(const Reclaimable&) = delete;
+			virtual ~Reclaimable() = default;
+
+		  private:
+			friend class EpochDomain;
+
+			/// @brief Next object retired to the domain. Guarded by the domain mutex.
+			Reclaimable* m_nextRetired = nullptr;
+
+			/// @brief Global epoch when the object was retired.
+			std::uint64_t m_retiredEpoch = 0;
+		};
+
+		/// @brief Epoch-based reclamation shared by every event. Readers pin the current global epoch in a record of their own thread
+		/// while they use published objects, so pinning only writes to a cache line no other thread writes. Writers retire the objects
+		/// they replaced, tagged with the global epoch. The epoch only advances once every pinned thread has caught up with it, so an
+		/// object retired at epoch E is destroyed once the global epoch reaches E + 2: every reader that could have loaded it unpinned.
+		/// A thread pinned for a long time, such as a handler that blocks, delays the destruction of every retired object.
+		/// The epoch, the pinned epochs and the published pointers are accessed with sequentially consistent operations: a reader that
+		/// loaded a replaced object announced its epoch before the writer read the epoch to tag it, so it blocks the advances that
+		/// would expire it.
+		class EpochDomain
+		{
+		  public:
+			EpochDomain(const EpochDomain&) = delete;
+			EpochDomain& operator=(const EpochDomain&) = delete;
+
+			/// @brief Returns the domain. It is never destroyed, so threads and static objects can use it until the program exits.
+			static EpochDomain& Instance()
+			{
+				static EpochDomain* domain = new EpochDomain();
+				return *domain;
+			}
+
+			/// @brief Pins the current epoch on the calling thread. Nested pins only count.
+			/// Claims a record for the thread on its first pin, which may throw std::bad_alloc.
+			void Pin()
+			{
+				ThreadRecord& record = LocalRecord();
+				if (record.depth++ == 0)
+				{
+					// Published objects are loaded after the pin is visible to the threads advancing the epoch
+					record.epoch.store(m_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+				}
+			}
+
+			/// @brief Unpins the calling thread once its outermost pin ends, then collects if retired objects are waiting.
+			void Unpin() noexcept
+			{
+				ThreadRecord& record = *t_record;
+				if (--record.depth > 0)
+				{
+					return;
+				}
+
+				record.epoch.store(Quiescent, std::memory_order_release);
+				if (m_retiredCount.load(std::memory_order_relaxed) != 0)
+				{
+					// Each thread collects once per epoch, so a thread pinned for long does not make the others contend on the mutex
+					const std::uint64_t epoch = m_epoch.load(std::memory_order_relaxed);
+					if (record.collectedEpoch != epoch)
+					{
+						record.collectedEpoch = epoch;
+						Collect();
+					}
+				}
+			}
+
+			/// @brief Hands an object no reader can load anymore to the domain, which destroys it once no reader can still use it.
+			/// Never allocates.
+			void Retire(Reclaimable* object) noexcept
+			{
+				std::lock_guard<SpinMutex> lock(m_mutex);
+
+				// The object was unpublished before the epoch it is tagged with is read
+				object->m_retiredEpoch = m_epoch.load(std::memory_order_seq_cst);
+				object->m_nextRetired = m_retired;
+				m_retired = object;
+				m_retiredCount.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			/// @brief Advances the epoch as far as the pinned threads allow, then destroys the retired objects that expired, outside
+			/// the domain mutex. Returns right away if another thread is collecting. When no thread is pinned, everything retired so
+			/// far is destroyed.
+			void Collect() noexcept
+			{
+				Reclaimable* expired = nullptr;
+				{
+					std::unique_lock<SpinMutex> lock(m_mutex, std::try_to_lock);
+					if (!lock)
+					{
+						return;
+					}
+
+					// Two advances are enough to expire every retired object
+					if (TryAdvance())
+					{
+						TryAdvance();
+					}
+
+					const std::uint64_t epoch = m_epoch.load(std::memory_order_relaxed);
+					for (Reclaimable** link = &m_retired; *link;)
+					{
+						Reclaimable* object = *link;
+						if (object->m_retiredEpoch + 2 <= epoch)
+						{
+							*link = object->m_nextRetired;
+							object->m_nextRetired = expired;
+							expired = object;
+							m_retiredCount.fetch_sub(1, std::memory_order_relaxed);
+						}
+						else
+						{
+							link = &object->m_nextRetired;
+						}
+					}
+				}
+
+				// Destroying an object may run handler destructors, which may retire and collect again
+				while (expired)
+				{
+					delete std::exchange(expired, expired->m_nextRetired);
+				}
+			}
+
+		  private:
+			/// @brief Epoch announced by a thread that is not pinned.
+			static constexpr std::uint64_t Quiescent = 0;
+
+			/// @brief Epoch announced by a thread, alone on its cache line so that pinning never contends with other threads.
+			struct alignas(64) ThreadRecord
+			{
+				/// @brief Pinned epoch, or Quiescent.
+				std::atomic<std::uint64_t> epoch{Quiescent};
+
+				/// @brief True while a thread owns the record.
+				std::atomic<bool> inUse{true};
+
+				/// @brief Number of nested pins. Only accessed by the owning thread.
+				std::size_t depth = 0;
+
+				/// @brief Epoch of the last collection made when unpinning. Only accessed by the owning thread.
+				std::uint64_t collectedEpoch = Quiescent;
+
+				/// @brief Next record of the domain. Records are never freed, so the list is only ever prepended to.
+				ThreadRecord* next = nullptr;
+			};
+
+			/// @brief Releases the record of a thread when it exits, so that a later thread can claim it.
+			struct RecordOwner
+			{
+				~RecordOwner()
+				{
+					if (t_record)
+					{
+						t_record->inUse.store(false, std::memory_order_release);
+						t_record = nullptr;
+					}
+				}
+			};
+
+			EpochDomain() = default;
+
+			/// @brief Returns the record of the calling thread, claiming one on first use.
+			ThreadRecord& LocalRecord()
+			{
+				if (!t_record)
+				{
+					t_record = Claim();
+					static thread_local RecordOwner owner;
+					(void)owner;
+				}
+				return *t_record;
+			}
+
+			/// @brief Takes a record released by an exited thread, or adds a new one.
+			ThreadRecord* Claim()
+			{
+				for (ThreadRecord* record = m_records.load(std::memory_order_acquire); record; record = record->next)
+				{
+					bool inUse = false;
+					if (!record->inUse.load(std::memory_order_relaxed) &&
+						record->inUse.compare_exchange_strong(inUse, true, std::memory_order_acquire))
+					{
+						return record;
+					}
+				}
+
+				ThreadRecord* record = new ThreadRecord();
+				record->next = m_records.load(std::memory_order_relaxed);
+
+				// Published before the first pin of the thread, so a scan that could miss the record cannot miss its pin either
+				while (!m_records.compare_exchange_weak(record->next, record, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+				}
+				return record;
+			}
+
+			/// @brief Advances the global epoch if every pinned thread announced it. Must be called with the domain mutex held.
+			/// @return True if the epoch advanced.
+			bool TryAdvance() noexcept
+			{
+				const std::uint64_t epoch = m_epoch.load(std::memory_order_seq_cst);
+				for (ThreadRecord* record = m_records.load(std::memory_order_seq_cst); record; record = record->next)
+				{
+					const std::uint64_t announced = record->epoch.load(std::memory_order_seq_cst);
+					if (announced != Quiescent && announced != epoch)
+					{
+						return false;
+					}
+				}
+				m_epoch.store(epoch + 1, std::memory_order_seq_cst);
+				return true;
+			}
+
+		  private:
+			/// @brief Record of the calling thread, null until its first pin.
+			static inline thread_local ThreadRecord* t_record = nullptr;
+
+			/// @brief Global epoch. Never Quiescent.
+			alignas(64) std::atomic<std::uint64_t> m_epoch{1};
+
+			/// @brief Records of every thread that ever pinned.
+			std::atomic<ThreadRecord*> m_records{nullptr};
+
+			/// @brief Number of retired objects not destroyed yet, so unpinning only collects when there is something to destroy.
+			std::atomic<std::size_t> m_retiredCount{0};
+
+			/// @brief Serializes retiring, advancing and collecting.
+			SpinMutex m_mutex;
+
+			/// @brief Retired objects not destroyed yet. Guarded by the mutex.
+			Reclaimable* m_retired = nullptr;
+		};
+
+		/// @brief Pins the epoch for its lifetime, so the objects loaded from a Publication stay alive while it is in scope.
+		class EpochGuard
+		{
+		  public:
+			EpochGuard() { EpochDomain::Instance().Pin(); }
+			EpochGuard(const EpochGuard&) = delete;
+			EpochGuard& operator=(const EpochGuard&) = delete;
+			~EpochGuard() { EpochDomain::Instance().Unpin(); }
+		};
+
+		/// @brief Guard of the readers of an object only used from a single thread, which never needs pinning.
+		class NullEpochGuard
+		{
+		  public:
+			NullEpochGuard() noexcept {}
+			NullEpochGuard(const NullEpochGuard&) = delete;
+			NullEpochGuard& operator=(const NullEpochGuard&) = delete;
+		};
+
+		/// @brief Guard readers hold while using the objects of a Publication.
+		template <bool Concurrent> using ReadGuard = std::conditional_t<Concurrent, EpochGuard, NullEpochGuard>;
+
+		/// @brief Releases an object that was replaced in a Publication: retires it to the epoch domain when readers of other threads
+		/// may still use it, deletes it otherwise.
+		struct RetiredRelease
+		{
+			/// @brief True to retire the object, false to delete it right away.
+			bool deferred = true;
+
+			void operator()(Reclaimable* object) const noexcept
+			{
+				if (!deferred)
+				{
+					delete object;
+					return;
+				}
+				EpochDomain::Instance().Retire(object);
+				EpochDomain::Instance().Collect();
+			}
+		};
+
+		/// @brief Object replaced in a Publication. Writers release it once their mutex is unlocked, since destroying it may run
+		/// handler destructors.
+		template <typename T> using Retired = std::unique_ptr<T, RetiredRelease>;
+
+		/// @brief Object published by writers and read by lock-free readers. When Concurrent, readers load it with a single atomic
+		/// load while holding an EpochGuard, and replaced objects are retired to the epoch domain; otherwise it is a plain owning
+		/// pointer and replaced objects are deleted when released.
+		template <typename T, bool Concurrent> class Publication;
+
+		template <typename T> class Publication<T, true>
+		{
+		  public:
+			Publication() = default;
+			Publication(const Publication&) = delete;
+			Publication& operator=(const Publication&) = delete;
+
+			/// @brief Retires the current object: a reader of the calling thread may still be using it.
+			~Publication() { const Retired<T> current(m_pointer.load(std::memory_order_relaxed)); }
+
+			/// @brief Returns the current object. Readers must hold an EpochGuard, writers the mutex.
+			T* Get() const noexcept { return m_pointer.load(std::memory_order_seq_cst); }
+
+			/// @brief Publishes an object. Must be called with the mutex held.
+			/// @return The previous object, to be released once the mutex is unlocked.
+			Retired<T> Exchange(std::unique_ptr<T> next) noexcept
+			{
+				return Retired<T>(m_pointer.exchange(next.release(), std::memory_order_seq_cst));
+			}
+
+		  private:
+			std::atomic<T*> m_pointer{nullptr};
+		};
+
+		template <typename T> class Publication<T, false>
+		{
+		  public:
+			T* Get() const noexcept { return m_pointer.get(); }
+
+			Retired<T> Exchange(std::unique_ptr<T> next) noexcept
+			{
+				return Retired<T>(std::exchange(m_pointer, std::move(next)).release(), RetiredRelease{false});
+			}
+
+		  private:
+			std::unique_ptr<T> m_pointer;
+		};
+	} // namespace detail
+} // namespace onion
@@ -1,122 +1,1436 @@
 #pragma once
 
-#include <functional>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include <onion/Dispatcher.hpp>
+#include <onion/Epoch.hpp>
+#include <onion/EventHandle.hpp>
+#include <onion/HandlerList.hpp>
+#include <onion/InlineFunction.hpp>
+#include <onion/MpscQueue.hpp>
+#include <onion/ThreadPool.hpp>
+#include <onion/ThreadingPolicy.hpp>
+#include <onion/TimerWheel.hpp>
+
 namespace onion
 {
-	/// @brief Represents a handle to an event subscription. Subscribed function won't be called anymore when the handle goes out of scope.
-	class EventHandle
+	/// @brief Controls when an event sweeps the handlers of ended subscriptions out of its handlers list.
+	/// Until then, ended subscriptions are only skipped by Trigger. A sweep happens once both thresholds are reached,
+	/// so its cost is amortized over the unsubscriptions that caused it.
+	struct ReclamationPolicy
 	{
-	  public:
-		template <typename EventArgs> friend class Event;
+		/// @brief Minimum number of expired handlers before sweeping.
+		std::size_t minExpiredHandlers = 16;
 
-	  public:
-		EventHandle() = default;
-		EventHandle(const EventHandle&) = default;
-		EventHandle(EventHandle&&) noexcept = default;
-		EventHandle& operator=(const EventHandle&) = default;
-		EventHandle& operator=(EventHandle&&) noexcept = default;
+		/// @brief Minimum fraction of expired handlers in the handlers list before sweeping.
+		double minExpiredRatio = 0.5;
+	};
+
+	/// @brief Order in which TriggerBatch delivers a batch of events.
+	enum class BatchOrder
+	{
+		/// @brief Every handler receives the first event, then every handler receives the second one, and so on, as if Trigger was
+		/// called for each event in turn. Batch subscribers are the exception to the priority order: they receive the whole batch
+		/// once every other handler received every event, whatever their priority.
+		EventMajor,
+
+		/// @brief The first handler receives every event, then the second handler receives every event, and so on, keeping the
+		/// code and the state of each handler hot in cache while it processes the batch. Handlers, batch subscribers included,
+		/// run in priority order.
+		HandlerMajor
+	};
+
+	/// @brief Receives the exception thrown by a delayed invocation of a rate-limited handler, on the thread advancing the wheel,
+	/// where nobody else could catch it. Must not throw.
+	using RateLimitErrorSink = void (*)(std::exception_ptr) noexcept;
+
+	/// @brief Subscription option invoking the handler at most once per interval: the first event is delivered at once, and the
+	/// latest of the events triggered during the following interval is delivered when it ends, from the thread advancing the wheel.
+	struct Throttle
+	{
+		/// @brief Minimum time between two invocations of the handler.
+		std::chrono::steady_clock::duration interval;
+
+		/// @brief Wheel timing the intervals. Null for TimerWheel::Shared(), which single-threaded events cannot use: they need
+		/// a manual wheel, advanced by their thread. The wheel must outlive the subscription.
+		TimerWheel* wheel = nullptr;
+
+		/// @brief Receives the exceptions thrown by the delayed invocations of the handler. Null to ignore them.
+		RateLimitErrorSink errorSink = nullptr;
+	};
 
-	  protected:
-		struct Token
+	/// @brief Subscription option invoking the handler once the event stopped being triggered for an interval, with the latest
+	/// arguments, from the thread advancing the wheel.
+	struct Debounce
+	{
+		/// @brief Quiet time after the last event before the handler is invoked.
+		std::chrono::steady_clock::duration interval;
+
+		/// @brief Wheel timing the intervals. Null for TimerWheel::Shared(), which single-threaded events cannot use: they need
+		/// a manual wheel, advanced by their thread. The wheel must outlive the subscription.
+		TimerWheel* wheel = nullptr;
+
+		/// @brief Receives the exceptions thrown by the delayed invocations of the handler. Null to ignore them.
+		RateLimitErrorSink errorSink = nullptr;
+	};
+
+	namespace detail
+	{
+		/// @brief How an event argument is passed to handlers: by value if it is trivially copyable and fits in two registers,
+		/// by const reference otherwise.
+		template <typename T>
+		using EventParameter = std::conditional_t<std::is_trivially_copyable_v<T> && sizeof(T) <= 2 * sizeof(void*), T, const T&>;
+
+		/// @brief Placeholder batch element of events carrying several arguments, which cannot be triggered in batches.
+		struct NoBatchElement
 		{
 		};
-		explicit EventHandle(std::shared_ptr<Token> handle) : m_handle(std::move(handle)) {}
 
-	  private:
-		std::shared_ptr<Token> m_handle;
-	};
+		/// @brief Element type of the batches of an event: its argument type if it has exactly one argument.
+		template <typename... Args> struct BatchElement
+		{
+			using Type = NoBatchElement;
+		};
+
+		template <typename Arg> struct BatchElement<Arg>
+		{
+			using Type = Arg;
+		};
+
+		/// @brief Callable adapting a batch subscriber to single events, which it receives as batches of one.
+		template <typename Element, typename Callable> struct BatchDelegate
+		{
+			mutable Callable callable;
+
+			void operator()(EventParameter<Element> args) const { callable(std::span<const Element>(&args, 1)); }
+		};
+
+		class WaiterList;
+
+		/// @brief Coroutine suspended until the next event, linked into the waiters list of the event. Lives in the coroutine frame.
+		struct EventWaiter
+		{
+			EventWaiter* previous = nullptr;
+			EventWaiter* next = nullptr;
+
+			/// @brief List the waiter is linked into, null once it is taken out to be resumed. Guarded by the event mutex.
+			WaiterList* list = nullptr;
+
+			std::coroutine_handle<> coroutine;
+		};
+
+		/// @brief Intrusive doubly linked list of waiters, in the order they started waiting. Guarded by the event mutex.
+		class WaiterList
+		{
+		  public:
+			bool IsEmpty() const noexcept { return m_first == nullptr; }
+
+			void PushBack(EventWaiter& waiter) noexcept
+			{
+				waiter.previous = m_last;
+				waiter.next = nullptr;
+				waiter.list = this;
+				(m_last ? m_last->next : m_first) = &waiter;
+				m_last = &waiter;
+			}
+
+			void Remove(EventWaiter& waiter) noexcept
+			{
+				(waiter.previous ? waiter.previous->next : m_first) = waiter.next;
+				(waiter.next ? waiter.next->previous : m_last) = waiter.previous;
+				waiter.previous = nullptr;
+				waiter.next = nullptr;
+				waiter.list = nullptr;
+			}
+
+			/// @brief Unlinks the first waiter.
+			/// @return The waiter, or nullptr if the list is empty.
+			EventWaiter* PopFront() noexcept
+			{
+				EventWaiter* waiter = m_first;
+				if (waiter)
+				{
+					Remove(*waiter);
+				}
+				return waiter;
+			}
+
+			/// @brief Moves every waiter of another list before the waiters of this one.
+			void Splice(WaiterList& other) noexcept
+			{
+				if (other.IsEmpty())
+				{
+					return;
+				}
+				for (EventWaiter* waiter = other.m_first; waiter; waiter = waiter->next)
+				{
+					waiter->list = this;
+				}
+				other.m_last->next = m_first;
+				(m_first ? m_first->previous : m_last) = other.m_last;
+				m_first = std::exchange(other.m_first, nullptr);
+				other.m_last = nullptr;
+			}
+
+			/// @brief Unlinks every waiter, which will never be resumed.
+			void Clear() noexcept
+			{
+				while (PopFront())
+				{
+				}
+			}
+
+		  private:
+			EventWaiter* m_first = nullptr;
+			EventWaiter* m_last = nullptr;
+		};
+
+		/// @brief What co_await event.Next() results in: nothing, the single argument, or a tuple of the arguments.
+		template <typename... Args> struct AwaitedEvent
+		{
+			using Type = std::tuple<std::decay_t<Args>...>;
+		};
+
+		template <> struct AwaitedEvent<>
+		{
+			using Type = void;
+		};
+
+		template <typename Arg> struct AwaitedEvent<Arg>
+		{
+			using Type = std::decay_t<Arg>;
+		};
+
+		/// @brief Identifies a subscription of an event, to check later whether it is still alive.
+		struct SubscriptionId
+		{
+			SubscriptionRegistry* registry = nullptr;
+			SubscriptionSlot* slot = nullptr;
+			std::uint32_t generation = 0;
+
+			/// @brief Returns true if the subscription has not ended. The registry must be alive.
+			bool IsAlive() const noexcept { return slot->generation.load(std::memory_order_acquire) == generation; }
+		};
+
+		/// @brief Drops a reference to a subscription registry.
+		struct RegistryRelease
+		{
+			void operator()(SubscriptionRegistry* registry) const noexcept { registry->ReleaseRef(); }
+		};
+
+		/// @brief Handler bound to a dispatcher, shared by the handlers list and the calls queued on the dispatcher.
+		/// Its subscription is filled in when it is added to the event, before the handler is published.
+		template <typename Callable> struct AffineTarget : SubscriptionId
+		{
+			AffineTarget(Dispatcher& owner, Callable&& handler) : dispatcher(owner), callable(std::move(handler)) {}
+
+			Dispatcher& dispatcher;
+			Callable callable;
+		};
+
+		/// @brief Event delivered to a handler bound to a dispatcher, queued on that dispatcher. Keeps the registry alive, so the
+		/// subscription can still be checked after the event is destroyed, and drops the event if it ended in the meantime.
+		template <typename Callable, typename... Args> struct AffineCall
+		{
+			std::shared_ptr<AffineTarget<Callable>> target;
+			std::unique_ptr<SubscriptionRegistry, RegistryRelease> registry;
+			std::tuple<std::decay_t<Args>...> args;
+
+			void operator()()
+			{
+				if (target->IsAlive())
+				{
+					std::apply(target->callable, args);
+				}
+			}
+		};
+
+		/// @brief How a rate-limited handler is invoked.
+		enum class RateLimit
+		{
+			Throttle,
+			Debounce
+		};
+
+		/// @brief Handler subscribed with a Throttle or a Debounce, shared by the handlers list and by its timer. It holds the latest
+		/// arguments the handler has not received yet. While its timer is scheduled, it keeps itself and the registry of its event
+		/// alive, so the timer can still check the subscription, and drop the arguments if it ended.
+		/// Its subscription is filled in when it is added to the event, before the handler is published.
+		template <typename Callable, typename... Args>
+		class RateLimitedTarget final : public SubscriptionId,
+										private TimerNode,
+										public std::enable_shared_from_this<RateLimitedTarget<Callable, Args...>>
+		{
+		  public:
+			RateLimitedTarget(TimerWheel& wheel, std::uint64_t interval, RateLimit limit, RateLimitErrorSink errorSink,
+							  Callable&& callable)
+				: m_wheel(wheel), m_interval(interval), m_limit(limit), m_errorSink(errorSink), m_callable(std::move(callable))
+			{
+				expire = &Expire;
+			}
+
+			/// @brief Invokes the handler at once, or keeps the arguments for the timer.
+			void operator()(EventParameter<Args>... args)
+			{
+				std::unique_lock<SpinMutex> lock(m_mutex);
+				if (m_limit == RateLimit::Throttle && !m_scheduled && !m_invoking)
+				{
+					// Deliver the first event of an interval right away. The interval is only timed once the handler returned, so the
+					// timer never delivers the events triggered meanwhile while it still runs
+					const std::uint64_t intervalEnd = m_wheel.Now() + m_interval;
+					m_invoking = true;
+					lock.unlock();
+					try
+					{
+						m_callable(args...);
+					}
+					catch (...)
+					{
+						EndImmediateCall(intervalEnd);
+						throw;
+					}
+					EndImmediateCall(intervalEnd);
+					return;
+				}
+
+				if (m_latest)
+				{
+					*m_latest = std::forward_as_tuple(args...);
+				}
+				else
+				{
+					m_latest.emplace(args...);
+				}
+				m_pending = true;
+
+				if (m_limit == RateLimit::Debounce)
+				{
+					// The timer is not moved: when it expires, it is scheduled again until the quiet time has elapsed
+					m_quietUntil = m_wheel.Now() + m_interval;
+					if (!m_scheduled)
+					{
+						Arm(m_quietUntil);
+					}
+				}
+			}
+
+		  private:
+			/// @brief Schedules the timer, which keeps the target and the registry alive. Must be called with the mutex held.
+			/// @param expiry The tick at which the timer expires.
+			void Arm(std::uint64_t expiry) noexcept
+			{
+				m_scheduled = true;
+				m_self = this->shared_from_this();
+				registry->AddRef();
+				m_registry.reset(registry);
+				m_wheel.Schedule(*this, expiry);
+			}
+
+			/// @brief Times the interval started by an immediate call of a throttled handler, once the handler returned.
+			/// @param intervalEnd The tick at which the interval ends, read before the handler was invoked.
+			void EndImmediateCall(std::uint64_t intervalEnd) noexcept
+			{
+				std::lock_guard<SpinMutex> lock(m_mutex);
+				m_invoking = false;
+				Arm(intervalEnd);
+			}
+
+			static void Expire(TimerNode& node, bool fired) noexcept
+			{
+				RateLimitedTarget& target = static_cast<RateLimitedTarget&>(node);
+
+				// Released once the handler returned, unless the timer is armed again
+				std::shared_ptr<RateLimitedTarget> self;
+				std::unique_ptr<SubscriptionRegistry, RegistryRelease> registry;
+				std::optional<std::tuple<std::decay_t<Args>...>> latest;
+				{
+					std::lock_guard<SpinMutex> lock(target.m_mutex);
+					self = std::move(target.m_self);
+					registry = std::move(target.m_registry);
+					target.m_scheduled = false;
+					if (!fired)
+					{
+						target.m_pending = false;
+						return;
+					}
+
+					const std::uint64_t now = target.m_wheel.Now();
+					if (target.m_limit == RateLimit::Debounce && target.m_quietUntil > now)
+					{
+						target.Arm(target.m_quietUntil);
+						return;
+					}
+					if (target.m_pending)
+					{
+						latest.emplace(std::move(*target.m_latest));
+						target.m_pending = false;
+						if (target.m_limit == RateLimit::Throttle)
+						{
+							target.Arm(now + target.m_interval);
+						}
+					}
+				}
+
+				if (latest && target.IsAlive())
+				{
+					// Nobody can catch an exception thrown on the thread advancing the wheel: it goes to the sink, if any
+					try
+					{
+						std::apply(target.m_callable, *latest);
+					}
+					catch (...)
+					{
+						if (target.m_errorSink)
+						{
+							target.m_errorSink(std::current_exception());
+						}
+					}
+				}
+			}
+
+		  private:
+			TimerWheel& m_wheel;
+
+			/// @brief Interval, in ticks of the wheel.
+			const std::uint64_t m_interval;
+
+			const RateLimit m_limit;
+
+			/// @brief Receives the exceptions thrown by delayed invocations, if not null.
+			const RateLimitErrorSink m_errorSink;
+
+			Callable m_callable;
+
+			/// @brief Guards the members below.
+			SpinMutex m_mutex;
+
+			/// @brief True while the timer is scheduled.
+			bool m_scheduled = false;
+
+			/// @brief True while a throttled handler is invoked right away, before its interval is timed.
+			bool m_invoking = false;
+
+			/// @brief True if m_latest holds arguments the handler has not received.
+			bool m_pending = false;
+
+			/// @brief Tick at which the quiet time of a debounced handler elapses.
+			std::uint64_t m_quietUntil = 0;
+
+			/// @brief Latest arguments. Keeps its storage once delivered, so the next event assigns into it.
+			std::optional<std::tuple<std::decay_t<Args>...>> m_latest;
+
+			/// @brief The target itself, while the timer is scheduled.
+			std::shared_ptr<RateLimitedTarget> m_self;
+
+			/// @brief Reference to the registry of the event, while the timer is scheduled.
+			std::unique_ptr<SubscriptionRegistry, RegistryRelease> m_registry;
+		};
+
+		/// @brief Callable stored in the handlers list for a rate-limited handler.
+		template <typename Target> struct RateLimitedDelegate
+		{
+			std::shared_ptr<Target> target;
+
+			template <typename... Values> void operator()(Values&&... args) const { (*target)(std::forward<Values>(args)...); }
+		};
+
+		/// @brief Callable stored in the handlers list for a handler bound to a dispatcher: it invokes the handler inline on the
+		/// owner thread of the dispatcher, and queues the event on the dispatcher from any other thread.
+		template <typename Callable, typename... Args> struct AffineDelegate
+		{
+			std::shared_ptr<AffineTarget<Callable>> target;
+
+			void operator()(EventParameter<Args>... args) const
+			{
+				if (target->dispatcher.IsCurrent())
+				{
+					target->callable(args...);
+					return;
+				}
+
+				target->registry->AddRef();
+				target->dispatcher.Post(AffineCall<Callable, Args...>{
+					target, std::unique_ptr<SubscriptionRegistry, RegistryRelease>(target->registry), {args...}});
+			}
+		};
+	} // namespace detail
 
 	/// @brief Generic event class that allows subscribing to, unsubscribing from, and triggering events with specific argument types.
-	/// @tparam EventArgs The type of the event arguments that will be passed to handlers when the event is triggered.
-	template <typename EventArgs> class Event
+	/// Use the Event, SpinLockedEvent and SingleThreadedEvent aliases rather than this class directly.
+	/// Handlers may subscribe, unsubscribe, clear or trigger the event they are invoked by. An unsubscribed handler is never invoked again,
+	/// even by the Trigger in progress, and a handler subscribed during a Trigger is not invoked by that Trigger.
+	/// With the SingleThreaded policy, Trigger iterates the handlers list in place, without pinning it: subscriptions and sweeps requested
+	/// while dispatching are deferred until the outermost Trigger returns, so nested Triggers do not invoke the new handlers either.
+	/// @tparam ThreadingPolicy How writers are serialized and how the handlers list is published: MultiThreaded, SpinLocked or SingleThreaded.
+	/// @tparam HandlerCapacity The size, in bytes, of the inline storage of each handler. Subscribing a handler that does not fit fails to compile.
+	/// @tparam Args The types of the arguments passed to handlers when the event is triggered, e.g. a single event arguments struct,
+	/// or several values such as (int id, double price).
+	template <typename ThreadingPolicy, std::size_t HandlerCapacity, typename... Args> class BasicEvent
 	{
 	  public:
-		/// @brief Subscribes a handler to the event. The handler will be invoked with the specified EventArgs when the event is triggered.
+		/// @brief Type in which handlers are stored. Handlers live inline in the handlers list and never allocate.
+		/// Small trivially copyable arguments are passed by value, the others by const reference.
+		using Handler = InlineFunction<void(detail::EventParameter<Args>...), HandlerCapacity>;
+
+		/// @brief Type of the elements of a batch given to TriggerBatch. Only events carrying a single argument can be triggered in batches.
+		using BatchElement = typename detail::BatchElement<Args...>::Type;
+
+		/// @brief What co_await event.Next() results in: nothing for an event without arguments, a copy of the argument for an event
+		/// carrying one, and a tuple of copies otherwise.
+		using AwaitedEvent = typename detail::AwaitedEvent<Args...>::Type;
+
+		/// @brief Awaitable returned by Next. It is the waiter itself: awaiting it links it into the waiters list of the event,
+		/// inside the coroutine frame. Destroying a suspended coroutine stops its wait.
+		class NextEventAwaiter;
+
+	  public:
+		BasicEvent() : m_core(new Core()) {}
+		BasicEvent(const BasicEvent&) = delete;
+		BasicEvent& operator=(const BasicEvent&) = delete;
+
+		/// @brief Destroys the handlers and drops the posted events that were not pumped. Outstanding EventHandles stay valid and become inert.
+		/// Coroutines waiting for the next event are never resumed; their owner remains responsible for destroying them.
+		~BasicEvent()
+		{
+			Clear();
+			while (m_core->posted.TryPop())
+			{
+			}
+			{
+				std::lock_guard<Mutex> lock(m_core->Mutex());
+				m_core->waiters.Clear();
+				m_core->hasWaiters.store(false, std::memory_order_relaxed);
+			}
+			if (m_core->IsDispatching())
+			{
+				// Destroyed by a handler: the outermost Trigger drops the reference of the event once it returns
+				m_core->orphaned = true;
+				return;
+			}
+			m_core->ReleaseRef();
+		}
+
+		/// @brief Subscribes a handler to the event. The handler will be invoked with the event arguments when the event is triggered.
 		/// The returned EventHandle is used as a token to manage the subscription's lifecycle.
-		/// @param handler The handler function to be invoked when the event is triggered.
+		/// Handlers run by decreasing priority, and in subscription order for equal priorities, except for the batch subscribers that
+		/// TriggerBatch invokes last in EventMajor order. The handlers list is kept in that order, so Trigger is a plain scan. Amortized constant time when the handler can be appended in place, which is the case when its
+		/// priority is not higher than the one of the last subscribed handler; otherwise the list is rebuilt with the handler at its position.
+		/// The list is also rebuilt when it is full or when the reclamation policy asks for a sweep.
+		/// @param handler The handler function to be invoked when the event is triggered. Its captures must fit in HandlerCapacity bytes.
+		/// @param priority The priority of the handler. Handlers of a higher priority are invoked first.
 		/// @return An EventHandle that is used to manage the subscription's lifecycle.
-		[[nodiscard]] EventHandle Subscribe(const std::function<void(const EventArgs&)>& handler)
+		template <typename Callable>
+			requires std::is_invocable_v<std::decay_t<Callable>&, detail::EventParameter<Args>...>
+		[[nodiscard]] EventHandle Subscribe(Callable&& handler, int priority = 0)
 		{
-			// Store the handle with a weak pointer to the handle ID
-			std::shared_ptr<EventHandle::Token> tokenPtr = std::make_shared<EventHandle::Token>();
+			return Add(Handler(std::forward<Callable>(handler)), nullptr, priority);
+		}
 
-			// Lock the mutex to safely modify the handlers vector
-			{
-				std::lock_guard<std::mutex> lock(m_mutex);
-				m_handlers.emplace_back(tokenPtr, handler);
-			}
+		/// @brief Subscribes a handler receiving whole batches: TriggerBatch invokes it once with the entire span, whatever the order,
+		/// after the other handlers when the order is EventMajor. Trigger invokes it with a batch of one event.
+		/// @param handler The handler function, invocable with a std::span<const BatchElement>. Its captures must fit in HandlerCapacity bytes.
+		/// @param priority The priority of the handler. Handlers of a higher priority are invoked first, except by TriggerBatch in
+		/// EventMajor order, which invokes batch subscribers after every other handler, whatever their priority.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle.
+		template <typename Callable>
+			requires(sizeof...(Args) == 1) && std::is_invocable_v<std::decay_t<Callable>&, std::span<const BatchElement>>
+		[[nodiscard]] EventHandle SubscribeBatch(Callable&& handler, int priority = 0)
+		{
+			using Delegate = detail::BatchDelegate<BatchElement, std::decay_t<Callable>>;
+			return Add(Handler(Delegate{std::forward<Callable>(handler)}), &InvokeBatch<Delegate>, priority);
+		}
+
+		/// @brief Subscribes a handler bound to a dispatcher: Trigger invokes it inline when called on the owner thread of the
+		/// dispatcher, and otherwise queues the event on the dispatcher, so the handler always runs on that thread and needs no lock.
+		/// A queued event is dropped if the subscription ends before the dispatcher runs it. Only available to events usable
+		/// from several threads.
+		/// @param dispatcher The dispatcher of the thread owning the handler. It must outlive the subscription.
+		/// @param handler The handler function. It is stored on the heap, shared with the queued events.
+		/// @param priority The priority of the handler. Handlers of a higher priority are invoked first.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle.
+		template <typename Callable>
+			requires(ThreadingPolicy::IsConcurrent) && std::is_invocable_v<std::decay_t<Callable>&, detail::EventParameter<Args>...>
+		[[nodiscard]] EventHandle Subscribe(Dispatcher& dispatcher, Callable&& handler, int priority = 0)
+		{
+			using Target = detail::AffineTarget<std::decay_t<Callable>>;
+			std::shared_ptr<Target> target = std::make_shared<Target>(dispatcher, std::decay_t<Callable>(std::forward<Callable>(handler)));
+			Target& subscription = *target;
+			return Add(Handler(detail::AffineDelegate<std::decay_t<Callable>, Args...>{std::move(target)}), nullptr, priority,
+					   &subscription);
+		}
+
+		/// @brief Subscribes a handler invoked at most once per interval. The first event of an interval is delivered at once,
+		/// on the triggering thread; the latest of the events triggered during the interval is delivered when it ends, on the thread
+		/// advancing the wheel. All the throttled handlers of a wheel share its single timer thread. The handler is never invoked by
+		/// two threads at once: the interval is timed once the immediate call returned.
+		/// @param handler The handler function. It is stored on the heap, with the latest arguments.
+		/// @param throttle The interval, the wheel timing it, which must outlive the subscription, and the sink of the exceptions
+		/// thrown by delayed invocations. A single-threaded event needs a manual wheel, advanced by its thread.
+		/// @param priority The priority of the handler. Handlers of a higher priority are invoked first.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle.
+		/// @throws std::invalid_argument If the event is single-threaded and the wheel is not manual.
+		template <typename Callable>
+			requires std::is_invocable_v<std::decay_t<Callable>&, detail::EventParameter<Args>...>
+		[[nodiscard]] EventHandle Subscribe(Callable&& handler, const Throttle& throttle, int priority = 0)
+		{
+			return SubscribeRateLimited(std::forward<Callable>(handler), throttle.wheel, throttle.interval, throttle.errorSink,
+										detail::RateLimit::Throttle, priority);
+		}
+
+		/// @brief Subscribes a handler invoked once the event stopped being triggered for an interval, with the latest arguments,
+		/// on the thread advancing the wheel.
+		/// @param handler The handler function. It is stored on the heap, with the latest arguments.
+		/// @param debounce The quiet interval, the wheel timing it, which must outlive the subscription, and the sink of the
+		/// exceptions thrown by delayed invocations. A single-threaded event needs a manual wheel, advanced by its thread.
+		/// @param priority The priority of the handler. Handlers of a higher priority are invoked first.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle.
+		/// @throws std::invalid_argument If the event is single-threaded and the wheel is not manual.
+		template <typename Callable>
+			requires std::is_invocable_v<std::decay_t<Callable>&, detail::EventParameter<Args>...>
+		[[nodiscard]] EventHandle Subscribe(Callable&& handler, const Debounce& debounce, int priority = 0)
+		{
+			return SubscribeRateLimited(std::forward<Callable>(handler), debounce.wheel, debounce.interval, debounce.errorSink,
+										detail::RateLimit::Debounce, priority);
+		}
 
-			// Clear expired handlers to keep the handlers vector clean
-			ClearExpired();
+		/// @brief Subscribes a member function of an object to the event, bound to a dispatcher: see Subscribe(Dispatcher&, Callable&&, int).
+		/// @tparam Method The member function to invoke, e.g. &MyClass::OnEvent.
+		/// @param dispatcher The dispatcher of the thread owning the object. It must outlive the subscription.
+		/// @param instance The object on which the member function is invoked. It must outlive the subscription.
+		/// @param priority The priority of the handler. Handlers of a higher priority are invoked first.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle.
+		template <auto Method, typename Class>
+			requires(ThreadingPolicy::IsConcurrent) && std::is_member_function_pointer_v<decltype(Method)> &&
+					std::is_invocable_v<decltype(Method), Class&, detail::EventParameter<Args>...>
+		[[nodiscard]] EventHandle Subscribe(Dispatcher& dispatcher, Class& instance, int priority = 0)
+		{
+			return Subscribe(dispatcher, detail::MemberDelegate<Method, Class>{&instance}, priority);
+		}
 
-			return EventHandle(tokenPtr);
+		/// @brief Subscribes a member function of an object to the event. Only the object pointer is stored; the member function is
+		/// bound at compile time, so invoking the handler costs a single indirect call.
+		/// The object must outlive the subscription.
+		/// @tparam Method The member function to invoke, e.g. &MyClass::OnEvent.
+		/// @param instance The object on which the member function is invoked.
+		/// @param priority The priority of the handler. Handlers of a higher priority are invoked first.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle.
+		template <auto Method, typename Class>
+			requires std::is_member_function_pointer_v<decltype(Method)> &&
+					 std::is_invocable_v<decltype(Method), Class&, detail::EventParameter<Args>...>
+		[[nodiscard]] EventHandle Subscribe(Class& instance, int priority = 0)
+		{
+			return Subscribe(detail::MemberDelegate<Method, Class>{&instance}, priority);
 		}
 
 		/// @brief Unsubscribes a handle from the event using the provided EventHandle.
+		/// Runs in constant time: the handle points directly to its slot, which bumps its generation and clears the handler liveness bit
+		/// so it is skipped from now on. The handler itself is destroyed lazily, when the reclamation policy triggers a sweep.
 		/// @param eventHandle The EventHandle representing the subscription to be removed.
 		void Unsubscribe(const EventHandle& eventHandle)
 		{
-			// Extract the handle ID from the EventHandle
-			std::shared_ptr<EventHandle::Token> handleId = eventHandle.m_handle;
+			if (eventHandle.m_registry != m_core)
+			{
+				return;
+			}
 
-			// Remove the handle with the matching ID
-			std::lock_guard<std::mutex> lock(m_mutex);
-			m_handlers.erase(std::remove_if(m_handlers.begin(),
-											m_handlers.end(),
-											[handleId](const auto& tuple)
-											{ return std::get<0>(tuple).lock() == handleId; }),
-							 m_handlers.end());
+			detail::Retired<HandlerList> previous;
+			std::lock_guard<Mutex> lock(m_core->Mutex());
+			if (m_core->Expire(*eventHandle.m_slot, eventHandle.m_generation))
+			{
+				previous = m_core->SweepIfNeeded();
+			}
 		}
 
-		/// @brief Triggers the event, invoking all subscribed handlers with the provided EventArgs. Invokes handlers in the same thread that calls this method.
+		/// @brief Triggers the event, invoking all subscribed handlers with the provided arguments. Invokes handlers in the same thread that calls this method.
+		/// The arguments are handed to every handler as they are, without being gathered into a temporary.
 		/// @param args The event arguments to be passed to each handler when the event is triggered.
-		void Trigger(const EventArgs& args) const
+		void Trigger(detail::EventParameter<Args>... args) const
 		{
-			// Create a temporary copy of the handlers to avoid holding the lock while invoking them
-			std::vector<std::tuple<std::weak_ptr<EventHandle::Token>, std::function<void(const EventArgs&)>>>
-				tmpHandlers;
+			const CoreReference waiting = ReferenceIfWaiting();
+			Dispatch([&args...](const HandlerList& handlers)
+					 { handlers.ForEachLive([&args...](const Handler& handler) { handler(args...); }); });
+			if (waiting)
 			{
-				std::lock_guard<std::mutex> lock(m_mutex);
-				tmpHandlers = m_handlers;
+				waiting->WakeWaiters(args...);
 			}
+		}
 
-			// Invoke handlers outside the lock to prevent potential deadlocks
-			for (const auto& [handleId, handler] : tmpHandlers)
+		/// @brief Triggers the event once per element of a batch, using the handlers list for the whole batch.
+		/// Batch subscribers receive the whole span in a single call: in EventMajor order, after every other handler received every
+		/// event, whatever their priority; in HandlerMajor order, at their priority position. Handlers subscribed while the batch is
+		/// delivered do not receive it, and a handler stops receiving it as soon as its subscription ends.
+		/// @param batch The event arguments, delivered in order.
+		/// @param order Whether all the handlers receive an event before the next one, or a handler receives all the events before the next handler.
+		void TriggerBatch(std::span<const BatchElement> batch, BatchOrder order = BatchOrder::EventMajor) const
+			requires(sizeof...(Args) == 1)
+		{
+			if (batch.empty())
 			{
-				if (auto lockedHandleId = handleId.lock())
+				return;
+			}
+
+			const CoreReference waiting = ReferenceIfWaiting();
+			Dispatch(
+				[batch, order](const HandlerList& handlers)
 				{
-					handler(args);
+					const std::size_t size = handlers.Size();
+					if (order == BatchOrder::HandlerMajor)
+					{
+						handlers.ForEachLiveIndex(size, HandlerList::Entries::All,
+												  [&handlers, batch](std::size_t index)
+												  {
+													  if (const BatchInvoker invoker = handlers.BatchInvokerAt(index))
+													  {
+														  invoker(handlers.HandlerAt(index), batch);
+														  return;
+													  }
+													  for (const BatchElement& element : batch)
+													  {
+														  if (!handlers.IsAlive(index))
+														  {
+															  return;
+														  }
+														  handlers.HandlerAt(index)(element);
+													  }
+												  });
+						return;
+					}
+
+					for (const BatchElement& element : batch)
+					{
+						handlers.ForEachLiveIndex(size, HandlerList::Entries::SingleEvent,
+												  [&handlers, &element](std::size_t index) { handlers.HandlerAt(index)(element); });
+					}
+					handlers.ForEachLiveIndex(size, HandlerList::Entries::Batch,
+											  [&handlers, batch](std::size_t index)
+											  { handlers.BatchInvokerAt(index)(handlers.HandlerAt(index), batch); });
+				});
+			if (waiting)
+			{
+				for (const BatchElement& element : batch)
+				{
+					waiting->WakeWaiters(element);
 				}
 			}
 		}
 
+		/// @brief Queues the event for the thread that calls Pump, typically the thread owning the handlers, and returns immediately.
+		/// Safe to call from any thread and lock-free: it allocates the queued event and links it with a single atomic exchange,
+		/// without touching the handlers list.
+		/// @param args The event arguments, copied into the queue.
+		void Post(detail::EventParameter<Args>... args) const { m_core->posted.Push(args...); }
+
+		/// @brief Triggers the posted events on the calling thread, in the order they were posted. Must not be called from several
+		/// threads at once. Events posted by the handlers while pumping are delivered by the same call, within the limit.
+		/// @param maxCount The maximum number of events to deliver.
+		/// @return The number of delivered events.
+		std::size_t Pump(std::size_t maxCount = std::numeric_limits<std::size_t>::max())
+		{
+			std::size_t delivered = 0;
+			while (delivered < maxCount)
+			{
+				std::optional<PostedEvent> posted = m_core->posted.TryPop();
+				if (!posted)
+				{
+					break;
+				}
+				++delivered;
+				std::apply([this](const auto&... args) { Trigger(args...); }, *posted);
+			}
+			return delivered;
+		}
+
+		/// @brief Queues the event on the thread pool and returns immediately. A worker invokes the handlers subscribed when it dequeues
+		/// the event, with copies of the arguments. Never blocks: when the queue of the pool is full, the event is dropped.
+		/// Only available to events usable from several threads.
+		/// @param args The event arguments, copied for the worker.
+		/// @return A Completion to wait for the handlers and get the exception one of them threw, which can be ignored.
+		/// It is empty if the event was dropped.
+		Completion TriggerAsync(detail::EventParameter<Args>... args) const
+			requires(ThreadingPolicy::IsConcurrent)
+		{
+			ThreadPool* pool = m_core->threadPool.load(std::memory_order_relaxed);
+			AsyncTrigger* trigger = new AsyncTrigger(*m_core, args...);
+			Completion completion(trigger);
+
+			// Reference of the task, dropped by Run
+			trigger->AddRef();
+			if (!(pool ? *pool : ThreadPool::Shared()).TryPost(ThreadPool::Task{&AsyncTrigger::Run, trigger}))
+			{
+				trigger->ReleaseRef();
+				return Completion();
+			}
+			return completion;
+		}
+
+		/// @brief Triggers the event, invoking the handlers in parallel on the thread pool and on the calling thread, then returns once
+		/// every handler returned. The handlers list is split into chunks of at least the parallel grain, which idle threads steal
+		/// from one another; a list holding a single chunk runs inline. Handlers must be safe to run concurrently with each other.
+		/// Only available to events usable from several threads.
+		/// @param args The event arguments to be passed to each handler. If handlers throw, the others still run and the first
+		/// exception is rethrown.
+		void TriggerParallel(detail::EventParameter<Args>... args) const
+			requires(ThreadingPolicy::IsConcurrent)
+		{
+			ThreadPool* pool = m_core->threadPool.load(std::memory_order_relaxed);
+			const std::size_t grain = m_core->parallelGrain.load(std::memory_order_relaxed);
+			const CoreReference waiting = ReferenceIfWaiting();
+			Dispatch(
+				[pool, grain, &args...](const HandlerList& handlers)
+				{
+					(pool ? *pool : ThreadPool::Shared())
+						.ParallelFor(handlers.Size(), grain,
+									 [&handlers, &args...](std::size_t begin, std::size_t end)
+									 {
+										 for (std::size_t index = begin; index < end; ++index)
+										 {
+											 if (handlers.IsAlive(index))
+											 {
+												 handlers.HandlerAt(index)(args...);
+											 }
+										 }
+									 });
+				});
+			if (waiting)
+			{
+				waiting->WakeWaiters(args...);
+			}
+		}
+
+		/// @brief Returns an awaitable suspending a coroutine until the next time the event is triggered, e.g.
+		/// auto args = co_await event.Next(). The coroutine is resumed by the thread triggering the event, after the handlers,
+		/// with copies of the arguments. Coroutines are resumed in the order they started waiting; one that waits again while
+		/// resumed waits for the following event. Waiting allocates nothing: the waiter lives in the coroutine frame.
+		/// @return The awaitable. It must be awaited at most once.
+		[[nodiscard]] NextEventAwaiter Next() const { return NextEventAwaiter(*m_core); }
+
+		/// @brief Sets the pool running the handlers of TriggerAsync and TriggerParallel, ThreadPool::Shared() by default.
+		/// @param pool The pool. It must outlive the events queued on it.
+		void SetThreadPool(ThreadPool& pool)
+			requires(ThreadingPolicy::IsConcurrent)
+		{
+			m_core->threadPool.store(&pool, std::memory_order_relaxed);
+		}
+
+		/// @brief Sets the minimum number of handlers per chunk of TriggerParallel. Lists holding a single chunk run inline.
+		/// @param grain The minimum number of handlers per chunk.
+		void SetParallelGrain(std::size_t grain)
+			requires(ThreadingPolicy::IsConcurrent)
+		{
+			m_core->parallelGrain.store(grain, std::memory_order_relaxed);
+		}
+
 		/// @brief Clears all handlers from the event, effectively unsubscribing all subscribers.
 		void Clear()
 		{
-			std::lock_guard<std::mutex> lock(m_mutex);
-			m_handlers.clear();
+			detail::Retired<HandlerList> previous;
+			std::vector<PendingHandler> pendingHandlers;
+			std::lock_guard<Mutex> lock(m_core->Mutex());
+			if (m_core->IsDispatching())
+			{
+				m_core->ExpireAllDeferred();
+				return;
+			}
+
+			// Handlers still pending after a failed attempt to apply them are dropped as well
+			pendingHandlers.swap(m_core->pendingHandlers);
+			for (const PendingHandler& pending : pendingHandlers)
+			{
+				m_core->Expire(*pending.binding.slot, pending.binding.generation);
+			}
+			m_core->ForgetExpiredHandlers(pendingHandlers.size());
+			m_core->sweepDeferred = false;
+
+			previous = m_core->Publish(nullptr);
+			if (previous)
+			{
+				const std::size_t size = previous->Size();
+				for (std::size_t i = 0; i < size; ++i)
+				{
+					const typename HandlerList::Binding& binding = previous->BindingAt(i);
+					m_core->Expire(*binding.slot, binding.generation);
+				}
+				m_core->ForgetExpiredHandlers(size);
+			}
 		}
 
 		/// @brief Clears all expired handlers from the event, removing all handlers that have gone out of scope.
 		void ClearExpired()
 		{
-			std::lock_guard<std::mutex> lock(m_mutex);
-			m_handlers.erase(std::remove_if(m_handlers.begin(),
-											m_handlers.end(),
-											[](const auto& tuple) { return std::get<0>(tuple).expired(); }),
-							 m_handlers.end());
+			detail::Retired<HandlerList> previous;
+			std::lock_guard<Mutex> lock(m_core->Mutex());
+			if (m_core->IsDispatching())
+			{
+				m_core->sweepDeferred = true;
+			}
+			else if (m_core->handlers.Get())
+			{
+				previous = m_core->Sweep(0);
+			}
+		}
+
+		/// @brief Sets when the handlers of ended subscriptions are swept out of the handlers list.
+		/// @param policy The new reclamation policy.
+		void SetReclamationPolicy(const ReclamationPolicy& policy)
+		{
+			std::lock_guard<Mutex> lock(m_core->Mutex());
+			m_core->reclamation = policy;
+		}
+
+		/// @brief Returns the number of handlers of alive subscriptions.
+		std::size_t LiveHandlerCount() const
+		{
+			const detail::ReadGuard<ThreadingPolicy::IsConcurrent> guard;
+			const HandlerList* handlers = m_core->handlers.Get();
+			const std::size_t stored = handlers ? handlers->Size() : 0;
+			const std::size_t expired = m_core->ExpiredHandlerCount();
+			return stored > expired ? stored - expired : 0;
+		}
+
+		/// @brief Returns the number of handlers of ended subscriptions that are still stored, waiting to be swept.
+		std::size_t ExpiredHandlerCount() const { return m_core->ExpiredHandlerCount(); }
+
+	  private:
+		using Mutex = typename ThreadingPolicy::Mutex;
+
+		/// @brief Arguments of an event queued by Post.
+		using PostedEvent = std::tuple<std::decay_t<Args>...>;
+
+		/// @brief Invokes a batch subscriber stored in a handler with a whole batch. Null for the other handlers.
+		using BatchInvoker = void (*)(const Handler&, std::span<const BatchElement>);
+
+		template <typename Delegate> static void InvokeBatch(const Handler& handler, std::span<const BatchElement> batch)
+		{
+			handler.template Target<Delegate>()->callable(batch);
+		}
+
+		/// @brief Handlers list of the event.
+		using HandlerList = detail::HandlerList<Handler, BatchInvoker>;
+
+		/// @brief Handler about to be inserted in the handlers list. Single-threaded events queue them while dispatching.
+		using PendingHandler = typename HandlerList::Entry;
+
+		/// @brief Shared state of the event: the slot registry, the writers mutex and the current handlers list.
+		/// It outlives the event while EventHandles refer to it.
+		struct Core final : detail::LockedSubscriptionRegistry<Mutex>
+		{
+			/// @brief Smallest capacity of a handlers list.
+			static constexpr std::size_t MinCapacity = 64;
+
+			/// @brief Default minimum number of handlers per chunk of TriggerParallel.
+			static constexpr std::size_t DefaultParallelGrain = 8;
+
+			/// @brief Current handlers list. Writers append to it or atomically publish a replacement, and Trigger only pins the epoch
+			/// and loads it, so firing the event neither allocates, copies any handler, nor takes the mutex. Pinning writes to a record
+			/// of the calling thread; unpinning may collect the objects retired meanwhile.
+			/// A replaced list is retired to the epoch domain, which destroys it once no Trigger can still be using it.
+			detail::Publication<HandlerList, ThreadingPolicy::IsConcurrent> handlers;
+
+			/// @brief When to sweep expired handlers. Guarded by the mutex.
+			ReclamationPolicy reclamation;
+
+			/// @brief Pool running the handlers of TriggerAsync and TriggerParallel. Null for ThreadPool::Shared().
+			std::atomic<ThreadPool*> threadPool{nullptr};
+
+			/// @brief Minimum number of handlers per chunk of TriggerParallel.
+			std::atomic<std::size_t> parallelGrain{DefaultParallelGrain};
+
+			/// @brief Events queued by Post, waiting for Pump.
+			detail::MpscQueue<PostedEvent> posted;
+
+			/// @brief Coroutines waiting for the next event. Guarded by the mutex.
+			detail::WaiterList waiters;
+
+			/// @brief True while coroutines may be waiting, so Trigger only takes the mutex when one is.
+			std::atomic<bool> hasWaiters{false};
+
+			/// @brief Number of nested Trigger calls in progress. Only counted by single-threaded events.
+			std::size_t dispatchDepth = 0;
+
+			/// @brief Subscriptions made while dispatching, in subscription order. Single-threaded events only.
+			std::vector<PendingHandler> pendingHandlers;
+
+			/// @brief True if a sweep was requested while dispatching. Single-threaded events only.
+			bool sweepDeferred = false;
+
+			/// @brief True once the event was destroyed by one of its handlers, so the outermost Trigger drops the reference of the
+			/// event when it returns. Single-threaded events only.
+			bool orphaned = false;
+
+			/// @brief Returns true if a single-threaded event is dispatching, so the handlers list must not be replaced.
+			bool IsDispatching() const noexcept
+			{
+				if constexpr (ThreadingPolicy::IsConcurrent)
+				{
+					return false;
+				}
+				return dispatchDepth > 0;
+			}
+
+			/// @brief Resumes the coroutines waiting for the next event, if any, with copies of the event arguments. The caller holds
+			/// a reference to the core, since a resumed coroutine may destroy the event.
+			void WakeWaiters(detail::EventParameter<Args>... args)
+			{
+				if (!hasWaiters.load(std::memory_order_acquire))
+				{
+					return;
+				}
+
+				// Waiters are taken out one at a time, so a resumed coroutine can still destroy the frame of a later one
+				detail::WaiterList waking;
+				{
+					std::lock_guard<Mutex> lock(this->Mutex());
+					waking.Splice(waiters);
+					hasWaiters.store(false, std::memory_order_relaxed);
+				}
+				for (;;)
+				{
+					NextEventAwaiter* waiter;
+					{
+						std::lock_guard<Mutex> lock(this->Mutex());
+						waiter = static_cast<NextEventAwaiter*>(waking.PopFront());
+					}
+					if (!waiter)
+					{
+						return;
+					}
+
+					try
+					{
+						waiter->m_event.emplace(args...);
+					}
+					catch (...)
+					{
+						// The waiters that were not resumed keep waiting, ahead of the ones that started waiting since
+						std::lock_guard<Mutex> lock(this->Mutex());
+						detail::WaiterList failed;
+						failed.PushBack(*waiter);
+						waking.Splice(failed);
+						waiters.Splice(waking);
+						hasWaiters.store(true, std::memory_order_relaxed);
+						throw;
+					}
+					waiter->coroutine.resume();
+				}
+			}
+
+			/// @brief Inserts a handler after the handlers of the same or a higher priority. It is appended in place when that keeps
+			/// the priority order, otherwise the list is rebuilt with the handler at its position. Must be called with the mutex held.
+			/// @param entry The handler to insert. It is only moved from when appended in place.
+			/// @return The previous list if it was replaced, to be released once the mutex is unlocked.
+			detail::Retired<HandlerList> Insert(PendingHandler& entry)
+			{
+				HandlerList* current = handlers.Get();
+				if (current && current->CanAppend(entry.binding.priority) && !ShouldSweep(*current))
+				{
+					current->Append(entry.binding, std::move(entry.handler));
+					current->BindSlot(current->Size() - 1);
+					return nullptr;
+				}
+				return Sweep(1, &entry);
+			}
+
+			/// @brief Ends every subscription, listed or pending, without replacing the list while dispatching. Must be called with the mutex held.
+			void ExpireAllDeferred() noexcept
+			{
+				if (const HandlerList* current = handlers.Get())
+				{
+					const std::size_t size = current->Size();
+					for (std::size_t i = 0; i < size; ++i)
+					{
+						const typename HandlerList::Binding& binding = current->BindingAt(i);
+						this->Expire(*binding.slot, binding.generation);
+					}
+				}
+				for (const PendingHandler& pending : pendingHandlers)
+				{
+					this->Expire(*pending.binding.slot, pending.binding.generation);
+				}
+				sweepDeferred = true;
+			}
+
+			/// @brief Returns true if mutations were deferred by the Trigger calls in progress.
+			bool HasDeferredMutations() const noexcept { return sweepDeferred || !pendingHandlers.empty(); }
+
+			/// @brief Applies the mutations deferred while dispatching: sweeps the list if requested or needed, then appends the pending
+			/// handlers whose subscription has not ended yet. Must be called with the mutex held, once the outermost Trigger returned.
+			/// @return The previous list if it was replaced, to be released once the mutex is unlocked.
+			detail::Retired<HandlerList> ApplyDeferred()
+			{
+				detail::Retired<HandlerList> previous;
+				if (sweepDeferred)
+				{
+					previous = Sweep(pendingHandlers.size());
+					sweepDeferred = false;
+				}
+
+				std::size_t applied = 0;
+				try
+				{
+					for (; applied < pendingHandlers.size(); ++applied)
+					{
+						PendingHandler& pending = pendingHandlers[applied];
+						if (pending.binding.slot->generation.load(std::memory_order_relaxed) != pending.binding.generation)
+						{
+							// Ended before being listed: it was counted as expired by Expire
+							this->ForgetExpiredHandlers(1);
+							continue;
+						}
+
+						// Intermediate lists were never used by a Trigger, so only the first replaced one is kept
+						detail::Retired<HandlerList> replaced = Insert(pending);
+						if (!previous)
+						{
+							previous = std::move(replaced);
+						}
+					}
+				}
+				catch (...)
+				{
+					pendingHandlers.erase(pendingHandlers.begin(), pendingHandlers.begin() + static_cast<std::ptrdiff_t>(applied));
+					throw;
+				}
+				pendingHandlers.clear();
+				return previous;
+			}
+
+			/// @brief Replaces the current handlers list. Must be called with the mutex held.
+			/// @return The previous list, to be released once the mutex is unlocked.
+			detail::Retired<HandlerList> Publish(std::unique_ptr<HandlerList> next)
+			{
+				return HandlerList::Publish(handlers, std::move(next));
+			}
+
+			/// @brief Returns true if the reclamation policy asks for a sweep of the given list. Must be called with the mutex held.
+			bool ShouldSweep(const HandlerList& list) const noexcept
+			{
+				const std::size_t expired = this->ExpiredHandlerCount();
+				return expired >= reclamation.minExpiredHandlers &&
+					   static_cast<double>(expired) >= reclamation.minExpiredRatio * static_cast<double>(list.Size());
+			}
+
+			/// @brief Publishes a new list holding only the live handlers, with room to grow. Must be called with the mutex held.
+			/// @param extraCapacity Number of handlers the caller is about to append.
+			/// @param insertion Handler to copy into the new list at its priority position, if any.
+			/// @return The previous list, to be released once the mutex is unlocked.
+			detail::Retired<HandlerList> Sweep(std::size_t extraCapacity, const PendingHandler* insertion = nullptr)
+			{
+				const HandlerList* current = handlers.Get();
+				const std::size_t size = current ? current->Size() : 0;
+				const std::size_t expired = this->ExpiredHandlerCount();
+				const std::size_t live = size > expired ? size - expired : 0;
+
+				const std::size_t capacity = 2 * (live + extraCapacity);
+				std::unique_ptr<HandlerList> next = HandlerList::Rebuild(current, capacity > MinCapacity ? capacity : MinCapacity, insertion);
+				this->ForgetExpiredHandlers(size - (next->Size() - (insertion ? 1 : 0)));
+
+				// Copying a handler may throw: the slots keep pointing into the current list until nothing can fail anymore
+				next->BindSlots();
+				return Publish(std::move(next));
+			}
+
+			/// @brief Sweeps the expired handlers if the reclamation policy asks for it. Must be called with the mutex held.
+			/// @return The previous list if a sweep happened, to be released once the mutex is unlocked.
+			detail::Retired<HandlerList> SweepIfNeeded()
+			{
+				const HandlerList* current = handlers.Get();
+				if (!current || !ShouldSweep(*current))
+				{
+					return nullptr;
+				}
+				if (IsDispatching())
+				{
+					// Swept once the outermost Trigger returns
+					sweepDeferred = true;
+					return nullptr;
+				}
+				return Sweep(0);
+			}
+
+		  protected:
+			detail::Retired<detail::Reclaimable> OnSubscriptionExpired(detail::SubscriptionSlot&) noexcept override
+			{
+				try
+				{
+					return SweepIfNeeded();
+				}
+				catch (...)
+				{
+					// Sweeping is an optimization: on failure, expired handlers are simply kept until the next sweep
+					return nullptr;
+				}
+			}
+		};
+
+		/// @brief Subscribes a handler through a rate-limited target timed by a wheel.
+		template <typename Callable>
+		EventHandle SubscribeRateLimited(Callable&& handler, TimerWheel* wheel, std::chrono::steady_clock::duration interval,
+										 RateLimitErrorSink errorSink, detail::RateLimit limit, int priority)
+		{
+			using Target = detail::RateLimitedTarget<std::decay_t<Callable>, Args...>;
+			if constexpr (!ThreadingPolicy::IsConcurrent)
+			{
+				if (!wheel || !wheel->IsManual())
+				{
+					throw std::invalid_argument("a rate-limited handler of a single-threaded event needs a manual wheel");
+				}
+			}
+			TimerWheel& timers = wheel ? *wheel : TimerWheel::Shared();
+			std::shared_ptr<Target> target =
+				std::make_shared<Target>(timers, timers.TicksFor(interval), limit, errorSink,
+										 std::decay_t<Callable>(std::forward<Callable>(handler)));
+			Target& subscription = *target;
+			return Add(Handler(detail::RateLimitedDelegate<Target>{std::move(target)}), nullptr, priority, &subscription);
+		}
+
+		/// @brief Subscribes a stored handler at its priority position, or queues it if a single-threaded event is dispatching.
+		/// @param subscription Filled in with the subscription before the handler is published, if not null.
+		EventHandle Add(Handler&& handler, BatchInvoker batchInvoker, int priority, detail::SubscriptionId* subscription = nullptr)
+		{
+			// The previous list is released once the mutex is unlocked, as destroying handlers may release handles
+			detail::Retired<HandlerList> previous;
+			std::lock_guard<Mutex> lock(m_core->Mutex());
+
+			detail::SubscriptionSlot* slot = m_core->AcquireSlot();
+			const std::uint32_t generation = slot->generation.load(std::memory_order_relaxed);
+			if (subscription)
+			{
+				*subscription = detail::SubscriptionId{m_core, slot, generation};
+			}
+			PendingHandler entry{{slot, generation, batchInvoker, priority}, std::move(handler)};
+			try
+			{
+				if (m_core->IsDispatching())
+				{
+					m_core->pendingHandlers.push_back(std::move(entry));
+				}
+				else
+				{
+					previous = m_core->Insert(entry);
+				}
+			}
+			catch (...)
+			{
+				m_core->AbandonSlot(*slot);
+				throw;
+			}
+
+			return EventHandle(m_core, slot, generation);
+		}
+
+		/// @brief Reference to the shared state of the event, dropped with it.
+		using CoreReference = std::unique_ptr<Core, detail::RegistryRelease>;
+
+		/// @brief Takes a reference to the shared state before the handlers run if coroutines are waiting, so they can be resumed
+		/// afterwards even if a handler destroyed the event. Once the handlers ran, the event must only be reached through it.
+		/// @return The reference, or null if no coroutine is waiting.
+		CoreReference ReferenceIfWaiting() const noexcept
+		{
+			if (!m_core->hasWaiters.load(std::memory_order_acquire))
+			{
+				return nullptr;
+			}
+			m_core->AddRef();
+			return CoreReference(m_core);
+		}
+
+		/// @brief Invokes a function with the current handlers list, if any, keeping it alive while the function runs.
+		template <typename Function> void Dispatch(Function&& function) const { Dispatch(*m_core, std::forward<Function>(function)); }
+
+		template <typename Function> static void Dispatch(Core& core, Function&& function)
+		{
+			if constexpr (!ThreadingPolicy::IsConcurrent)
+			{
+				// The list cannot be replaced while dispatching, so it is used in place
+				const DispatchScope scope(core);
+				if (const HandlerList* handlers = core.handlers.Get())
+				{
+					function(*handlers);
+				}
+				return;
+			}
+
+			// Pin the epoch without taking the mutex, so the current list is not destroyed while it is used even if it is replaced;
+			// handlers appended after this point are not visible to this call
+			const detail::EpochGuard guard;
+			const HandlerList* handlers = core.handlers.Get();
+
+			if (!handlers)
+			{
+				return;
+			}
+
+			// Invoke handlers outside the lock to prevent potential deadlocks
+			function(*handlers);
+		}
+
+		/// @brief Event queued by TriggerAsync: a copy of the arguments and a reference to the shared state of the event, so it can
+		/// still be dispatched after the event is destroyed, to no handler.
+		class AsyncTrigger final : public detail::CompletionState
+		{
+		  public:
+			explicit AsyncTrigger(Core& core, detail::EventParameter<Args>... args) : m_core(core), m_args(args...)
+			{
+				m_core.AddRef();
+			}
+
+			~AsyncTrigger() override { m_core.ReleaseRef(); }
+
+			/// @brief Invokes the handlers, completes the operation and drops the reference of the task.
+			static void Run(void* context) noexcept
+			{
+				AsyncTrigger* trigger = static_cast<AsyncTrigger*>(context);
+				std::exception_ptr exception;
+				try
+				{
+					std::apply(
+						[trigger](const auto&... args)
+						{
+							Dispatch(trigger->m_core, [&args...](const HandlerList& handlers)
+									 { handlers.ForEachLive([&args...](const Handler& handler) { handler(args...); }); });
+							trigger->m_core.WakeWaiters(args...);
+						},
+						trigger->m_args);
+				}
+				catch (...)
+				{
+					exception = std::current_exception();
+				}
+				trigger->Complete(std::move(exception));
+				trigger->ReleaseRef();
+			}
+
+		  private:
+			Core& m_core;
+			std::tuple<std::decay_t<Args>...> m_args;
+		};
+
+		/// @brief Counts a Trigger of a single-threaded event as dispatching, and applies the deferred mutations when the outermost one returns.
+		/// The shared state owns the handlers list used in place; a handler destroying the event leaves it orphaned instead of
+		/// releasing it, so the Trigger keeps it alive without touching the reference count.
+		class DispatchScope
+		{
+		  public:
+			explicit DispatchScope(Core& core) noexcept : m_core(core) { ++m_core.dispatchDepth; }
+			DispatchScope(const DispatchScope&) = delete;
+			DispatchScope& operator=(const DispatchScope&) = delete;
+
+			~DispatchScope()
+			{
+				if (--m_core.dispatchDepth > 0)
+				{
+					return;
+				}
+				if (m_core.orphaned)
+				{
+					{
+						// The event cleared its handlers when destroyed: drop the ones it kept for the Trigger calls
+						const detail::Retired<HandlerList> previous = m_core.Publish(nullptr);
+						const std::vector<PendingHandler> pendingHandlers = std::move(m_core.pendingHandlers);
+					}
+					m_core.ReleaseRef();
+					return;
+				}
+				if (m_core.HasDeferredMutations())
+				{
+					detail::Retired<HandlerList> previous;
+					try
+					{
+						previous = m_core.ApplyDeferred();
+					}
+					catch (...)
+					{
+						// The mutations not applied yet are retried when the next outermost Trigger returns
+					}
+				}
+			}
+
+		  private:
+			Core& m_core;
+		};
+
+	  private:
+		/// @brief Shared state of the event, referenced by the EventHandles it issued.
+		Core* m_core;
+	};
+
+	template <typename ThreadingPolicy, std::size_t HandlerCapacity, typename... Args>
+	class BasicEvent<ThreadingPolicy, HandlerCapacity, Args...>::NextEventAwaiter : private detail::EventWaiter
+	{
+	  public:
+		NextEventAwaiter(const NextEventAwaiter&) = delete;
+		NextEventAwaiter& operator=(const NextEventAwaiter&) = delete;
+
+		~NextEventAwaiter()
+		{
+			{
+				// The list is only read under the mutex, since a Trigger on another thread may be taking the waiter out of it
+				std::lock_guard<Mutex> lock(m_core->Mutex());
+				if (list)
+				{
+					list->Remove(*this);
+				}
+			}
+			m_core->ReleaseRef();
+		}
+
+		bool await_ready() const noexcept { return false; }
+
+		void await_suspend(std::coroutine_handle<> suspended)
+		{
+			coroutine = suspended;
+			std::lock_guard<Mutex> lock(m_core->Mutex());
+			m_core->waiters.PushBack(*this);
+			m_core->hasWaiters.store(true, std::memory_order_release);
+		}
+
+		AwaitedEvent await_resume()
+		{
+			if constexpr (sizeof...(Args) == 1)
+			{
+				return std::move(std::get<0>(*m_event));
+			}
+			else if constexpr (sizeof...(Args) > 1)
+			{
+				return std::move(*m_event);
+			}
 		}
 
 	  private:
-		/// @brief Mutex to protect access to the handlers vector, ensuring thread safety when subscribing, unsubscribing, and triggering events.
-		mutable std::mutex m_mutex;
+		friend class BasicEvent;
+		friend struct Core;
+
+		explicit NextEventAwaiter(Core& core) noexcept : m_core(&core) { m_core->AddRef(); }
+
+		/// @brief Shared state of the event, kept alive by the awaiter.
+		Core* m_core;
 
-		/// @brief Storage for event handlers, using a weak pointer to the handle ID to allow for automatic cleanup when handlers are unsubscribed or go out of scope.
-		std::vector<std::tuple<std::weak_ptr<EventHandle::Token>, std::function<void(const EventArgs&)>>> m_handlers;
+		/// @brief Arguments of the event, set right before the coroutine is resumed.
+		std::optional<PostedEvent> m_event;
 	};
+
+	/// @brief Event usable from any thread. Writers are serialized on a std::mutex, Trigger never locks.
+	/// Use BasicEvent directly to choose another handler capacity.
+	template <typename... Args> using Event = BasicEvent<MultiThreaded, DefaultInlineFunctionCapacity, Args...>;
+
+	/// @brief Event usable from any thread, whose writers are serialized on a spin lock.
+	template <typename... Args> using SpinLockedEvent = BasicEvent<SpinLocked, DefaultInlineFunctionCapacity, Args...>;
+
+	/// @brief Event used from a single thread, without any lock.
+	template <typename... Args> using SingleThreadedEvent = BasicEvent<SingleThreaded, DefaultInlineFunctionCapacity, Args...>;
 } // namespace onion
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <onion/Event.hpp>
+
+namespace onion
+{
+	namespace detail
+	{
+		/// @brief Returns a new type index. Indices are dense: they count the types used with an EventBus so far.
+		inline std::size_t NextTypeIndex() noexcept
+		{
+			static std::atomic<std::size_t> next{0};
+			return next.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		/// @brief Returns the index of a type, assigned on first use without RTTI. Each type keeps the same index for the whole program,
+		/// as long as it is linked into a single binary.
+		template <typename T> std::size_t TypeIndex() noexcept
+		{
+			static const std::size_t index = NextTypeIndex();
+			return index;
+		}
+	} // namespace detail
+
+	/// @brief Holds one event per argument type, so a single object can carry events of arbitrary types.
+	/// Events are found by indexing a dense array with the type index of their argument type: no typeid, no hashing.
+	/// Use the EventBus alias rather than this class directly.
+	/// @tparam ThreadingPolicy How writers are serialized and how the events are published: MultiThreaded, SpinLocked or SingleThreaded.
+	/// @tparam HandlerCapacity The size, in bytes, of the inline storage of each handler.
+	template <typename ThreadingPolicy, std::size_t HandlerCapacity> class BasicEventBus
+	{
+	  public:
+		/// @brief Event carrying the arguments of type T.
+		template <typename T> using EventFor = BasicEvent<ThreadingPolicy, HandlerCapacity, T>;
+
+	  public:
+		BasicEventBus() = default;
+		BasicEventBus(const BasicEventBus&) = delete;
+		BasicEventBus& operator=(const BasicEventBus&) = delete;
+
+		/// @brief Subscribes a handler to the events of type T.
+		/// @tparam T The type of the event arguments, e.g. bus.Subscribe<MyEventArgs>(handler).
+		/// @param handler The handler function to be invoked when an event of type T is triggered.
+		/// @param priority The priority of the handler. Handlers of a higher priority are invoked first.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle.
+		template <typename T, typename Callable>
+			requires std::is_invocable_v<std::decay_t<Callable>&, detail::EventParameter<T>>
+		[[nodiscard]] EventHandle Subscribe(Callable&& handler, int priority = 0)
+		{
+			return FindOrAdd<T>().Subscribe(std::forward<Callable>(handler), priority);
+		}
+
+		/// @brief Subscribes a member function of an object to the events of type T. The object must outlive the subscription.
+		/// @tparam T The type of the event arguments.
+		/// @tparam Method The member function to invoke, e.g. &MyClass::OnEvent.
+		/// @param instance The object on which the member function is invoked.
+		/// @param priority The priority of the handler. Handlers of a higher priority are invoked first.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle.
+		template <typename T, auto Method, typename Class>
+			requires std::is_member_function_pointer_v<decltype(Method)> &&
+					 std::is_invocable_v<decltype(Method), Class&, detail::EventParameter<T>>
+		[[nodiscard]] EventHandle Subscribe(Class& instance, int priority = 0)
+		{
+			return FindOrAdd<T>().template Subscribe<Method>(instance, priority);
+		}
+
+		/// @brief Unsubscribes a handle from the events of type T. Destroying the last copy of the handle has the same effect.
+		/// @param eventHandle The EventHandle representing the subscription to be removed.
+		template <typename T> void Unsubscribe(const EventHandle& eventHandle)
+		{
+			const detail::ReadGuard<ThreadingPolicy::IsConcurrent> guard;
+			if (EventFor<T>* event = Find<T>())
+			{
+				event->Unsubscribe(eventHandle);
+			}
+		}
+
+		/// @brief Triggers the event of type T, invoking the handlers subscribed to it. Invokes handlers in the same thread that calls
+		/// this method. Does nothing if no handler was ever subscribed to T.
+		/// @param args The event arguments to be passed to each handler.
+		template <typename T> void Trigger(const T& args) const
+		{
+			// The event triggers under the pin of the lookup, which its own pin only nests into
+			const detail::ReadGuard<ThreadingPolicy::IsConcurrent> guard;
+			if (const EventFor<T>* event = Find<T>())
+			{
+				event->Trigger(args);
+			}
+		}
+
+		/// @brief Clears the handlers of every type, effectively unsubscribing all subscribers.
+		void Clear()
+		{
+			std::lock_guard<Mutex> lock(m_mutex);
+			for (const Entry& entry : m_entries)
+			{
+				entry.clear(entry.event.get());
+			}
+		}
+
+		/// @brief Returns the number of handlers of alive subscriptions to the events of type T.
+		template <typename T> std::size_t LiveHandlerCount() const
+		{
+			const detail::ReadGuard<ThreadingPolicy::IsConcurrent> guard;
+			const EventFor<T>* event = Find<T>();
+			return event ? event->LiveHandlerCount() : 0;
+		}
+
+	  private:
+		using Mutex = typename ThreadingPolicy::Mutex;
+
+		/// @brief Dense array mapping type indices to events. It has a fixed capacity and only gains entries: an entry is published by
+		/// storing its event pointer with release semantics, so a writer can add an event while readers index the array.
+		/// It is replaced by a larger one when a type index does not fit.
+		class EventTable final : public detail::Reclaimable
+		{
+		  public:
+			explicit EventTable(std::size_t capacity)
+				: m_capacity(capacity), m_events(std::make_unique<std::atomic<void*>[]>(capacity))
+			{
+			}
+
+			/// @brief Returns the event of a type index, or nullptr if there is none.
+			void* Find(std::size_t index) const noexcept
+			{
+				return index < m_capacity ? m_events[index].load(std::memory_order_acquire) : nullptr;
+			}
+
+			/// @brief Returns true if the table has an entry for the type index. Writers only.
+			bool Fits(std::size_t index) const noexcept { return index < m_capacity; }
+
+			/// @brief Publishes the event of a type index. Must be called with the mutex held.
+			void Set(std::size_t index, void* event) noexcept { m_events[index].store(event, std::memory_order_release); }
+
+		  private:
+			std::size_t m_capacity;
+			std::unique_ptr<std::atomic<void*>[]> m_events;
+		};
+
+		/// @brief Event of a type, owned by the bus, with the type index it is stored at.
+		struct Entry
+		{
+			std::size_t index;
+			std::shared_ptr<void> event;
+			void (*clear)(void*);
+		};
+
+		/// @brief Smallest capacity of an event table.
+		static constexpr std::size_t MinTableCapacity = 16;
+
+		template <typename T> static void ClearEvent(void* event) { static_cast<EventFor<T>*>(event)->Clear(); }
+
+		/// @brief Returns the event of type T, or nullptr if no handler was ever subscribed to T. Does not lock nor pin: the caller
+		/// holds a ReadGuard while the table is read. Events live as long as the bus, so the returned one stays valid afterwards.
+		template <typename T> EventFor<T>* Find() const
+		{
+			const EventTable* table = m_table.Get();
+			return table ? static_cast<EventFor<T>*>(table->Find(detail::TypeIndex<T>())) : nullptr;
+		}
+
+		/// @brief Returns the event of type T, creating it if needed.
+		template <typename T> EventFor<T>& FindOrAdd()
+		{
+			const std::size_t index = detail::TypeIndex<T>();
+
+			// A replaced table is released once the mutex is unlocked
+			detail::Retired<EventTable> previous;
+			std::lock_guard<Mutex> lock(m_mutex);
+			EventTable* table = m_table.Get();
+			if (table)
+			{
+				if (void* event = table->Find(index))
+				{
+					return *static_cast<EventFor<T>*>(event);
+				}
+			}
+
+			m_entries.reserve(m_entries.size() + 1);
+			std::shared_ptr<EventFor<T>> event = std::make_shared<EventFor<T>>();
+			if (!table || !table->Fits(index))
+			{
+				previous = Grow(index);
+				table = m_table.Get();
+			}
+
+			table->Set(index, event.get());
+			m_entries.push_back(Entry{index, event, &ClearEvent<T>});
+			return *event;
+		}
+
+		/// @brief Builds a table holding every event, with an entry for the given type index, then publishes it.
+		/// Must be called with the mutex held.
+		/// @return The previous table, to be released once the mutex is unlocked.
+		detail::Retired<EventTable> Grow(std::size_t index)
+		{
+			std::size_t capacity = MinTableCapacity;
+			while (capacity <= index)
+			{
+				capacity *= 2;
+			}
+
+			std::unique_ptr<EventTable> table = std::make_unique<EventTable>(capacity);
+			for (const Entry& entry : m_entries)
+			{
+				table->Set(entry.index, entry.event.get());
+			}
+			return m_table.Exchange(std::move(table));
+		}
+
+	  private:
+		/// @brief Serializes the writers of the event table.
+		Mutex m_mutex;
+
+		/// @brief Current event table. Trigger loads it under an EpochGuard; replaced tables are retired to the epoch domain.
+		detail::Publication<EventTable, ThreadingPolicy::IsConcurrent> m_table;
+
+		/// @brief Events owned by the bus. They are never destroyed before the bus, so the tables can refer to them.
+		std::vector<Entry> m_entries;
+	};
+
+	/// @brief Event bus usable from any thread. Writers are serialized on a std::mutex, Trigger never locks.
+	using EventBus = BasicEventBus<MultiThreaded, DefaultInlineFunctionCapacity>;
+} // namespace onion
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <onion/Epoch.hpp>
+
+namespace onion
+{
+	namespace detail
+	{
+		/// @brief Bookkeeping of a single subscription. Slots are recycled: the generation tells the subscription currently using the slot
+		/// apart from the previous ones, so a handler is alive only while its recorded generation matches the slot generation.
+		struct SubscriptionSlot
+		{
+			/// @brief Incremented each time the subscription using the slot ends.
+			std::atomic<std::uint32_t> generation{0};
+
+			/// @brief Number of EventHandle copies referring to the slot. The slot is recycled when it drops to zero.
+			std::atomic<std::uint32_t> handles{0};
+
+			/// @brief Word of the handlers list liveness bitset holding the bit of the subscription. Guarded by the registry mutex.
+			std::atomic<std::uint64_t>* liveWord = nullptr;
+
+			/// @brief Mask of the subscription bit in liveWord. Guarded by the registry mutex.
+			std::uint64_t liveMask = 0;
+
+			/// @brief Next slot in the free list, when the slot is not in use.
+			SubscriptionSlot* nextFree = nullptr;
+
+			/// @brief Handlers of the subscription, for events keeping several handlers lists, such as one per key. Guarded by the
+			/// registry mutex.
+			void* owner = nullptr;
+		};
+
+		/// @brief Owns the subscription slots of an event. It is reference counted by the event and by every EventHandle it issued,
+		/// so handles stay valid after the event is destroyed. The writers mutex is provided by LockedSubscriptionRegistry,
+		/// according to the threading policy of the event.
+		class SubscriptionRegistry
+		{
+		  public:
+			SubscriptionRegistry() = default;
+			SubscriptionRegistry(const SubscriptionRegistry&) = delete;
+			SubscriptionRegistry& operator=(const SubscriptionRegistry&) = delete;
+			virtual ~SubscriptionRegistry() = default;
+
+			/// @brief Adds a reference to the registry.
+			void AddRef() noexcept { m_references.fetch_add(1, std::memory_order_relaxed); }
+
+			/// @brief Removes a reference to the registry, destroying it when it was the last one.
+			void ReleaseRef() noexcept
+			{
+				if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					delete this;
+				}
+			}
+
+			/// @brief Takes a slot from the free list, growing the slot storage if needed. Must be called with the mutex held.
+			/// @return A slot referenced by one handle, whose current generation identifies the new subscription,
+			/// or nullptr if every slot of a fixed-capacity registry is in use.
+			SubscriptionSlot* AcquireSlot()
+			{
+				if (!m_freeSlots)
+				{
+					if (m_fixedCapacity)
+					{
+						return nullptr;
+					}
+					Grow();
+				}
+
+				SubscriptionSlot* slot = m_freeSlots;
+				m_freeSlots = slot->nextFree;
+				slot->nextFree = nullptr;
+				slot->handles.store(1, std::memory_order_relaxed);
+				return slot;
+			}
+
+			/// @brief Returns a slot that was just acquired, and never handed to an EventHandle, to the free list.
+			/// Used when subscribing fails after the slot was acquired. Must be called with the mutex held.
+			void AbandonSlot(SubscriptionSlot& slot) noexcept
+			{
+				slot.handles.store(0, std::memory_order_relaxed);
+				slot.nextFree = m_freeSlots;
+				m_freeSlots = &slot;
+			}
+
+			/// @brief Ends the subscription identified by a slot and a generation, if it is still alive, and clears its liveness bit.
+			/// Constant time. Must be called with the mutex held.
+			/// @return True if the subscription was alive.
+			bool Expire(SubscriptionSlot& slot, std::uint32_t generation) noexcept
+			{
+				if (slot.generation.load(std::memory_order_relaxed) != generation)
+				{
+					return false;
+				}
+
+				slot.generation.store(generation + 1, std::memory_order_relaxed);
+				if (slot.liveWord)
+				{
+					slot.liveWord->fetch_and(~slot.liveMask, std::memory_order_release);
+					slot.liveWord = nullptr;
+				}
+				m_expiredHandlers.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+
+			/// @brief Number of ended subscriptions whose handler is still in the handlers list, waiting to be swept.
+			std::size_t ExpiredHandlerCount() const noexcept { return m_expiredHandlers.load(std::memory_order_relaxed); }
+
+			/// @brief Records that handlers of ended subscriptions have been swept out of the handlers list. Must be called with the mutex held.
+			/// @param count The number of swept handlers.
+			void ForgetExpiredHandlers(std::size_t count) noexcept
+			{
+				m_expiredHandlers.fetch_sub(count, std::memory_order_relaxed);
+			}
+
+			/// @brief Drops a handle reference to a slot. The last reference ends the subscription and recycles the slot.
+			void ReleaseSlot(SubscriptionSlot& slot, std::uint32_t generation) noexcept
+			{
+				if (slot.handles.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				{
+					return;
+				}
+
+				// Storage released by the event is destroyed once the mutex is unlocked
+				Retired<Reclaimable> released;
+				Lock();
+				if (Expire(slot, generation))
+				{
+					released = OnSubscriptionExpired(slot);
+				}
+				slot.nextFree = m_freeSlots;
+				m_freeSlots = &slot;
+				Unlock();
+			}
+
+		  protected:
+			/// @brief Locks the writers mutex.
+			virtual void Lock() noexcept = 0;
+
+			/// @brief Unlocks the writers mutex.
+			virtual void Unlock() noexcept = 0;
+
+			/// @brief Makes the registry use the given slots only, so it never allocates. Must be called before any slot is acquired.
+			/// @param slots The slots, owned by the caller and outliving the registry.
+			/// @param count The number of slots.
+			void UseFixedSlots(SubscriptionSlot* slots, std::size_t count) noexcept
+			{
+				m_fixedCapacity = true;
+				for (std::size_t i = count; i-- > 0;)
+				{
+					slots[i].nextFree = m_freeSlots;
+					m_freeSlots = &slots[i];
+				}
+			}
+
+			/// @brief Called with the mutex held after the last handle of an alive subscription is released.
+			/// Lets the event decide whether to sweep the expired handlers.
+			/// @param slot The slot of the subscription, not recycled yet.
+			/// @return Storage to destroy once the mutex is unlocked, if any.
+			virtual Retired<Reclaimable> OnSubscriptionExpired(SubscriptionSlot&) noexcept { return nullptr; }
+
+		  private:
+			/// @brief Allocates a new chunk of slots, twice as large as the previous one, and adds them to the free list.
+			void Grow()
+			{
+				const std::size_t chunkSize = FirstChunkSize << (m_chunks.size() < MaxChunkShift ? m_chunks.size() : MaxChunkShift);
+				m_chunks.reserve(m_chunks.size() + 1);
+				m_chunks.push_back(std::make_unique<SubscriptionSlot[]>(chunkSize));
+
+				SubscriptionSlot* chunk = m_chunks.back().get();
+				for (std::size_t i = chunkSize; i-- > 0;)
+				{
+					chunk[i].nextFree = m_freeSlots;
+					m_freeSlots = &chunk[i];
+				}
+			}
+
+		  private:
+			static constexpr std::size_t FirstChunkSize = 16;
+			static constexpr std::size_t MaxChunkShift = 12;
+
+			/// @brief References held by the event and by the handles.
+			std::atomic<std::size_t> m_references{1};
+
+			/// @brief Slot storage. Chunks are never moved or freed before the registry, so slot addresses are stable.
+			std::vector<std::unique_ptr<SubscriptionSlot[]>> m_chunks;
+
+			/// @brief Head of the list of unused slots.
+			SubscriptionSlot* m_freeSlots = nullptr;
+
+			/// @brief True if the registry only uses the slots given to UseFixedSlots.
+			bool m_fixedCapacity = false;
+
+			/// @brief Ended subscriptions whose handler has not been swept yet. Modified with the mutex held.
+			std::atomic<std::size_t> m_expiredHandlers{0};
+		};
+
+		/// @brief Subscription registry holding the writers mutex of an event.
+		/// @tparam MutexType The type of the mutex, given by the threading policy of the event.
+		template <typename MutexType> class LockedSubscriptionRegistry : public SubscriptionRegistry
+		{
+		  public:
+			/// @brief Mutex serializing every modification of the event and of its slots.
+			MutexType& Mutex() noexcept { return m_mutex; }
+
+		  protected:
+			void Lock() noexcept override { m_mutex.lock(); }
+			void Unlock() noexcept override { m_mutex.unlock(); }
+
+		  private:
+			MutexType m_mutex;
+		};
+	} // namespace detail
+
+	/// @brief Represents a handle to an event subscription. Subscribed function won't be called anymore when the handle goes out of scope.
+	/// Copies of a handle share the same subscription, which ends when the last copy is destroyed.
+	class EventHandle
+	{
+	  public:
+		template <typename ThreadingPolicy, std::size_t HandlerCapacity, typename... Args> friend class BasicEvent;
+		template <typename ThreadingPolicy, std::size_t HandlerCapacity, typename Key, typename... Args> friend class BasicKeyedEvent;
+		template <typename ThreadingPolicy, std::size_t HandlerCapacity, std::size_t Capacity, typename EventArgs>
+		friend class BasicStaticEvent;
+
+	  public:
+		EventHandle() = default;
+
+		EventHandle(const EventHandle& other) noexcept
+			: m_registry(other.m_registry), m_slot(other.m_slot), m_generation(other.m_generation)
+		{
+			if (m_registry)
+			{
+				m_registry->AddRef();
+				m_slot->handles.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		EventHandle(EventHandle&& other) noexcept
+			: m_registry(std::exchange(other.m_registry, nullptr)), m_slot(std::exchange(other.m_slot, nullptr)),
+			  m_generation(other.m_generation)
+		{
+		}
+
+		EventHandle& operator=(const EventHandle& other) noexcept
+		{
+			EventHandle copy(other);
+			Swap(copy);
+			return *this;
+		}
+
+		EventHandle& operator=(EventHandle&& other) noexcept
+		{
+			EventHandle moved(std::move(other));
+			Swap(moved);
+			return *this;
+		}
+
+		~EventHandle()
+		{
+			if (m_registry)
+			{
+				m_registry->ReleaseSlot(*m_slot, m_generation);
+				m_registry->ReleaseRef();
+			}
+		}
+
+		/// @brief Returns true if the handle refers to a subscription, false if it is default constructed, moved from,
+		/// or was returned by a fixed-capacity event that was full.
+		explicit operator bool() const noexcept { return m_registry != nullptr; }
+
+	  protected:
+		/// @brief Adopts the handle reference of a freshly acquired slot.
+		EventHandle(detail::SubscriptionRegistry* registry, detail::SubscriptionSlot* slot, std::uint32_t generation) noexcept
+			: m_registry(registry), m_slot(slot), m_generation(generation)
+		{
+			m_registry->AddRef();
+		}
+
+	  private:
+		void Swap(EventHandle& other) noexcept
+		{
+			std::swap(m_registry, other.m_registry);
+			std::swap(m_slot, other.m_slot);
+			std::swap(m_generation, other.m_generation);
+		}
+
+	  private:
+		/// @brief Registry owning the slot. Kept alive by the handle.
+		detail::SubscriptionRegistry* m_registry = nullptr;
+
+		/// @brief Slot of the subscription.
+		detail::SubscriptionSlot* m_slot = nullptr;
+
+		/// @brief Generation of the slot at subscription time, identifying the subscription.
+		std::uint32_t m_generation = 0;
+	};
+} // namespace onion
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include <onion/Epoch.hpp>
+#include <onion/EventHandle.hpp>
+
+namespace onion
+{
+	namespace detail
+	{
+		/// @brief Handlers list in structure-of-arrays layout: a packed liveness bitset, the contiguous handlers, and the
+		/// subscription each handler belongs to. Trigger scans the bitset and only touches the handlers of alive subscriptions.
+		/// The list has a fixed capacity and is append-only: entries are published by incrementing the size with release semantics,
+		/// so a writer can append while readers iterate over the entries published before they started.
+		/// Published handlers are never modified; only their liveness bit is cleared when their subscription ends.
+		/// Slots only track the bit of the current list, so once a list is replaced, the Trigger calls still using it also check the
+		/// generation of the slot of each entry before invoking it.
+		/// The handlers, the bindings and both bitsets share a single allocation sized for the exact capacity, so a small list,
+		/// such as the list of a single key, costs one allocation besides the list itself.
+		/// @tparam Handler The type in which handlers are stored.
+		/// @tparam BatchInvoker The type of the function invoking a batch subscriber, null for the other handlers.
+		template <typename Handler, typename BatchInvoker> class HandlerList final : public Reclaimable
+		{
+		  public:
+			/// @brief Subscription a handler belongs to. Only read by writers, when sweeping, except for the batch invoker, and for the
+			/// slot and generation once the list is retired.
+			struct Binding
+			{
+				SubscriptionSlot* slot;
+				std::uint32_t generation;
+				BatchInvoker batchInvoker;
+				int priority;
+			};
+
+			/// @brief Handler about to be inserted in a list, with its subscription.
+			struct Entry
+			{
+				Binding binding;
+				Handler handler;
+			};
+
+			/// @brief Entries visited by ForEachLiveIndex.
+			enum class Entries
+			{
+				All,
+				SingleEvent,
+				Batch
+			};
+
+		  public:
+			/// @param capacity The number of entries the list can hold. Must not be zero.
+			explicit HandlerList(std::size_t capacity)
+				: m_capacity(capacity), m_storageSize(StorageSize(capacity)), m_handlers(std::allocator<Handler>().allocate(m_storageSize)),
+				  m_bindings(reinterpret_cast<Binding*>(m_handlers + capacity)),
+				  m_live(reinterpret_cast<std::atomic<std::uint64_t>*>(m_bindings + capacity)), m_batch(m_live + WordCount(capacity))
+			{
+				std::uninitialized_value_construct_n(m_live, 2 * WordCount(capacity));
+			}
+
+			HandlerList(const HandlerList&) = delete;
+			HandlerList& operator=(const HandlerList&) = delete;
+
+			~HandlerList() override
+			{
+				const std::size_t size = m_size.load(std::memory_order_relaxed);
+				for (std::size_t i = 0; i < size; ++i)
+				{
+					m_handlers[i].~Handler();
+				}
+				std::allocator<Handler>().deallocate(m_handlers, m_storageSize);
+			}
+
+			/// @brief Builds a list holding the alive entries of another one, in order, plus a new entry after the entries of the
+			/// same or a higher priority. Its slots are left untouched until BindSlots. Must be called with the mutex held.
+			/// @param list The list to copy the alive entries of, or nullptr.
+			/// @param capacity The capacity of the new list. Must hold the alive entries and the insertion.
+			/// @param insertion The entry to copy into the new list at its priority position, or nullptr.
+			static std::unique_ptr<HandlerList> Rebuild(const HandlerList* list, std::size_t capacity, const Entry* insertion)
+			{
+				std::unique_ptr<HandlerList> next = std::make_unique<HandlerList>(capacity);
+				const std::size_t size = list ? list->Size() : 0;
+				for (std::size_t i = 0; i < size; ++i)
+				{
+					if (list->IsAlive(i))
+					{
+						const Binding& binding = list->BindingAt(i);
+						if (insertion && binding.priority < insertion->binding.priority)
+						{
+							next->Append(insertion->binding, insertion->handler);
+							insertion = nullptr;
+						}
+						next->Append(binding, list->HandlerAt(i));
+					}
+				}
+				if (insertion)
+				{
+					next->Append(insertion->binding, insertion->handler);
+				}
+				return next;
+			}
+
+			/// @brief Replaces the list of a publication, retiring the current one. Must be called with the mutex held.
+			/// @return The previous list, to be released once the mutex is unlocked.
+			template <bool Concurrent>
+			static Retired<HandlerList> Publish(Publication<HandlerList, Concurrent>& publication, std::unique_ptr<HandlerList> next) noexcept
+			{
+				if (HandlerList* previous = publication.Get())
+				{
+					previous->Retire();
+				}
+				return publication.Exchange(std::move(next));
+			}
+
+			/// @brief Number of published entries, alive or not.
+			std::size_t Size() const noexcept { return m_size.load(std::memory_order_acquire); }
+
+			/// @brief Returns true when no entry can be appended anymore. Writers only.
+			bool IsFull() const noexcept { return m_size.load(std::memory_order_relaxed) == m_capacity; }
+
+			/// @brief Returns true if an entry of the given priority can be appended in place without breaking the priority order,
+			/// because the list is not full and its last entry has the same or a higher priority. Writers only.
+			bool CanAppend(int priority) const noexcept
+			{
+				const std::size_t size = m_size.load(std::memory_order_relaxed);
+				return size < m_capacity && (size == 0 || m_bindings[size - 1].priority >= priority);
+			}
+
+			/// @brief Returns true if the subscription of the entry at the given index has not ended.
+			bool IsAlive(std::size_t index) const noexcept
+			{
+				if (!((m_live[index / BitsPerWord].load(std::memory_order_acquire) >> (index % BitsPerWord)) & 1))
+				{
+					return false;
+				}
+				return !m_retired.load(std::memory_order_acquire) || IsBindingAlive(index);
+			}
+
+			/// @brief Marks the list as replaced by another one, whose bits are cleared from now on instead of the ones of this list.
+			/// Must be called with the mutex held, before the replacement is published.
+			void Retire() noexcept { m_retired.store(true, std::memory_order_release); }
+
+			/// @brief Binding of the entry at the given index. Writers only.
+			const Binding& BindingAt(std::size_t index) const noexcept { return m_bindings[index]; }
+
+			/// @brief Handler of the entry at the given index.
+			const Handler& HandlerAt(std::size_t index) const noexcept { return m_handlers[index]; }
+
+			/// @brief Batch invoker of the entry at the given index, null unless it is a batch subscriber.
+			BatchInvoker BatchInvokerAt(std::size_t index) const noexcept { return m_bindings[index].batchInvoker; }
+
+			/// @brief Invokes a function with the handler of every alive subscription published when the call starts.
+			template <typename Function> void ForEachLive(Function&& function) const
+			{
+				ForEachLiveIndex(Size(), Entries::All, [this, &function](std::size_t index) { function(m_handlers[index]); });
+			}
+
+			/// @brief Invokes a function with the index of every alive entry among the first ones.
+			/// @param size The number of entries to consider, read from Size beforehand.
+			/// @param entries Whether to visit all entries, only the batch subscribers, or only the others.
+			template <typename Function> void ForEachLiveIndex(std::size_t size, Entries entries, Function&& function) const
+			{
+				const std::size_t words = WordCount(size);
+				for (std::size_t word = 0; word < words; ++word)
+				{
+					std::uint64_t bits = m_live[word].load(std::memory_order_acquire);
+					if (entries == Entries::SingleEvent)
+					{
+						bits &= ~m_batch[word].load(std::memory_order_relaxed);
+					}
+					else if (entries == Entries::Batch)
+					{
+						bits &= m_batch[word].load(std::memory_order_relaxed);
+					}
+
+					// Ignore entries appended after the size was read
+					const std::size_t remaining = size - word * BitsPerWord;
+					if (remaining < BitsPerWord)
+					{
+						bits &= (std::uint64_t{1} << remaining) - 1;
+					}
+
+					while (bits != 0)
+					{
+						const std::size_t index = word * BitsPerWord + static_cast<std::size_t>(std::countr_zero(bits));
+						bits &= bits - 1;
+						if (m_retired.load(std::memory_order_acquire) && !IsBindingAlive(index))
+						{
+							continue;
+						}
+						function(index);
+
+						// The handler may have ended the subscriptions of the entries left in the word
+						bits &= m_live[word].load(std::memory_order_acquire);
+					}
+				}
+			}
+
+			/// @brief Constructs a new alive entry after the published ones, then publishes it. Its slot is left untouched until
+			/// BindSlot, so a list that fails to build never leaks into a slot. The list must not be full. Must be called with the mutex held.
+			template <typename HandlerType> void Append(const Binding& binding, HandlerType&& handler)
+			{
+				const std::size_t index = m_size.load(std::memory_order_relaxed);
+				::new (static_cast<void*>(m_handlers + index)) Handler(std::forward<HandlerType>(handler));
+				m_bindings[index] = binding;
+
+				const std::uint64_t mask = std::uint64_t{1} << (index % BitsPerWord);
+				if (binding.batchInvoker)
+				{
+					m_batch[index / BitsPerWord].fetch_or(mask, std::memory_order_relaxed);
+				}
+				m_live[index / BitsPerWord].fetch_or(mask, std::memory_order_relaxed);
+
+				m_size.store(index + 1, std::memory_order_release);
+			}
+
+			/// @brief Points the slot of an entry at its liveness bit, so ending the subscription clears it. Must be called with the mutex held.
+			void BindSlot(std::size_t index) noexcept
+			{
+				SubscriptionSlot& slot = *m_bindings[index].slot;
+				slot.liveWord = &m_live[index / BitsPerWord];
+				slot.liveMask = std::uint64_t{1} << (index % BitsPerWord);
+			}
+
+			/// @brief Binds the slots of every entry, once the list is complete and about to be published. Must be called with the mutex held.
+			void BindSlots() noexcept
+			{
+				const std::size_t size = m_size.load(std::memory_order_relaxed);
+				for (std::size_t i = 0; i < size; ++i)
+				{
+					BindSlot(i);
+				}
+			}
+
+		  private:
+			static constexpr std::size_t BitsPerWord = 64;
+
+			static_assert(alignof(Binding) <= alignof(Handler) && alignof(std::atomic<std::uint64_t>) <= alignof(Binding),
+						  "the storage of a list is laid out by decreasing alignment");
+
+			/// @brief Number of bitset words holding the bits of the given number of entries.
+			static constexpr std::size_t WordCount(std::size_t entries) noexcept { return (entries + BitsPerWord - 1) / BitsPerWord; }
+
+			/// @brief Size of the storage of a list, in handlers: the handlers, then the bindings, then the liveness and batch bitsets.
+			static constexpr std::size_t StorageSize(std::size_t capacity) noexcept
+			{
+				const std::size_t bytes = capacity * (sizeof(Handler) + sizeof(Binding)) + 2 * WordCount(capacity) * sizeof(std::uint64_t);
+				return (bytes + sizeof(Handler) - 1) / sizeof(Handler);
+			}
+
+			/// @brief Returns true if the subscription recorded for an entry still owns its slot.
+			bool IsBindingAlive(std::size_t index) const noexcept
+			{
+				const Binding& binding = m_bindings[index];
+				return binding.slot->generation.load(std::memory_order_acquire) == binding.generation;
+			}
+
+			/// @brief Maximum number of entries.
+			std::size_t m_capacity;
+
+			/// @brief Size of the storage, in handlers.
+			std::size_t m_storageSize;
+
+			/// @brief Contiguous handlers, constructed up to the size. Start of the storage.
+			Handler* m_handlers;
+
+			/// @brief Subscription of each entry.
+			Binding* m_bindings;
+
+			/// @brief Liveness bitset, one bit per entry.
+			std::atomic<std::uint64_t>* m_live;
+
+			/// @brief Batch subscribers bitset, one bit per entry. Set before the entry is published.
+			std::atomic<std::uint64_t>* m_batch;
+
+			/// @brief Number of published entries.
+			std::atomic<std::size_t> m_size{0};
+
+			/// @brief Set once the list is replaced: its liveness bits are no longer cleared.
+			std::atomic<bool> m_retired{false};
+		};
+	} // namespace detail
+} // namespace onion
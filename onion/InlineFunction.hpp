@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace onion
+{
+	/// @brief Default size, in bytes, of the inline buffer of an InlineFunction. Large enough for a lambda capturing four pointers or a std::function.
+	inline constexpr std::size_t DefaultInlineFunctionCapacity = 4 * sizeof(void*);
+
+	template <typename Signature, std::size_t Capacity = DefaultInlineFunctionCapacity> class InlineFunction;
+
+	namespace detail
+	{
+		/// @brief Callable invoking a compile-time bound member function on an object. Holds nothing but the object pointer,
+		/// so it always fits in an InlineFunction.
+		template <auto Method, typename Class> struct MemberDelegate
+		{
+			Class* instance;
+
+			template <typename... Args> void operator()(Args&&... args) const
+			{
+				(instance->*Method)(std::forward<Args>(args)...);
+			}
+		};
+	} // namespace detail
+
+	/// @brief Type-erased callable stored entirely inside the object, in a fixed-size buffer. Unlike std::function, it never allocates:
+	/// a callable that does not fit in the buffer is rejected at compile time.
+	/// @tparam R The return type of the callable.
+	/// @tparam Params The parameter types of the callable.
+	/// @tparam Capacity The size, in bytes, of the inline buffer.
+	template <typename R, typename... Params, std::size_t Capacity> class InlineFunction<R(Params...), Capacity>
+	{
+	  public:
+		InlineFunction() = default;
+
+		/// @brief Stores a copy of the given callable in the inline buffer.
+		/// @tparam Callable The type of the callable. Must fit in Capacity bytes, be copyable and be nothrow movable.
+		/// @param callable The callable to store.
+		template <typename Callable>
+			requires(!std::is_same_v<std::remove_cvref_t<Callable>, InlineFunction> &&
+					 std::is_invocable_r_v<R, std::decay_t<Callable>&, Params...>)
+		InlineFunction(Callable&& callable) // NOLINT(google-explicit-constructor)
+		{
+			using Stored = std::decay_t<Callable>;
+			static_assert(sizeof(Stored) <= Capacity,
+						  "Callable does not fit in the InlineFunction buffer: reduce its captures or increase the capacity");
+			static_assert(alignof(Stored) <= alignof(std::max_align_t), "Callable is over-aligned for the InlineFunction buffer");
+			static_assert(std::is_copy_constructible_v<Stored>, "Callable stored in an InlineFunction must be copyable");
+			static_assert(std::is_nothrow_move_constructible_v<Stored>,
+						  "Callable stored in an InlineFunction must be nothrow move constructible");
+
+			::new (static_cast<void*>(m_storage)) Stored(std::forward<Callable>(callable));
+			m_invoke = &Invoke<Stored>;
+			m_manage = &Manage<Stored>;
+		}
+
+		InlineFunction(const InlineFunction& other)
+		{
+			if (other.m_manage)
+			{
+				other.m_manage(Operation::Copy, m_storage, const_cast<std::byte*>(other.m_storage));
+				m_invoke = other.m_invoke;
+				m_manage = other.m_manage;
+			}
+		}
+
+		InlineFunction(InlineFunction&& other) noexcept
+		{
+			if (other.m_manage)
+			{
+				other.m_manage(Operation::Move, m_storage, other.m_storage);
+				m_invoke = std::exchange(other.m_invoke, nullptr);
+				m_manage = std::exchange(other.m_manage, nullptr);
+			}
+		}
+
+		InlineFunction& operator=(const InlineFunction& other)
+		{
+			if (this != &other)
+			{
+				InlineFunction copy(other);
+				*this = std::move(copy);
+			}
+			return *this;
+		}
+
+		InlineFunction& operator=(InlineFunction&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Reset();
+				if (other.m_manage)
+				{
+					other.m_manage(Operation::Move, m_storage, other.m_storage);
+					m_invoke = std::exchange(other.m_invoke, nullptr);
+					m_manage = std::exchange(other.m_manage, nullptr);
+				}
+			}
+			return *this;
+		}
+
+		~InlineFunction() { Reset(); }
+
+		/// @brief Invokes the stored callable. The InlineFunction must not be empty.
+		R operator()(Params... params) const
+		{
+			return m_invoke(const_cast<std::byte*>(m_storage), std::forward<Params>(params)...);
+		}
+
+		/// @brief Returns true if a callable is stored.
+		explicit operator bool() const noexcept { return m_invoke != nullptr; }
+
+		/// @brief Returns the stored callable if it is of type T, nullptr otherwise.
+		template <typename T> T* Target() const noexcept
+		{
+			return m_invoke == &Invoke<T> ? std::launder(reinterpret_cast<T*>(const_cast<std::byte*>(m_storage))) : nullptr;
+		}
+
+		/// @brief Destroys the stored callable, leaving the InlineFunction empty.
+		void Reset() noexcept
+		{
+			if (m_manage)
+			{
+				m_manage(Operation::Destroy, m_storage, nullptr);
+				m_invoke = nullptr;
+				m_manage = nullptr;
+			}
+		}
+
+	  private:
+		enum class Operation
+		{
+			Copy,
+			Move,
+			Destroy
+		};
+
+		template <typename Stored> static R Invoke(void* storage, Params&&... params)
+		{
+			return static_cast<R>((*static_cast<Stored*>(storage))(std::forward<Params>(params)...));
+		}
+
+		template <typename Stored> static void Manage(Operation operation, void* destination, void* source)
+		{
+			switch (operation)
+			{
+				case Operation::Copy:
+					::new (destination) Stored(*static_cast<const Stored*>(source));
+					break;
+				case Operation::Move:
+					::new (destination) Stored(std::move(*static_cast<Stored*>(source)));
+					static_cast<Stored*>(source)->~Stored();
+					break;
+				case Operation::Destroy:
+					static_cast<Stored*>(destination)->~Stored();
+					break;
+			}
+		}
+
+	  private:
+		/// @brief Inline buffer holding the callable.
+		alignas(std::max_align_t) std::byte m_storage[Capacity];
+
+		/// @brief Calls the stored callable. Null when empty.
+		R (*m_invoke)(void*, Params&&...) = nullptr;
+
+		/// @brief Copies, moves or destroys the stored callable. Null when empty.
+		void (*m_manage)(Operation, void*, void*) = nullptr;
+	};
+} // namespace onion
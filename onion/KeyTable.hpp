@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <onion/Epoch.hpp>
+
+namespace onion
+{
+	namespace detail
+	{
+		/// @brief Hashes a key with std::hash, then spreads the bits so that the low bits used to index a table are well distributed.
+		template <typename Key> std::size_t HashKey(const Key& key)
+		{
+			const std::uint64_t hash = static_cast<std::uint64_t>(std::hash<Key>{}(key)) * 0x9E3779B97F4A7C15ull;
+			return static_cast<std::size_t>(hash ^ (hash >> 32));
+		}
+
+		/// @brief Open-addressing hash table with linear probing, mapping keys to values owned elsewhere. It has a fixed capacity
+		/// and is append-only: a bucket is published by storing its value pointer with release semantics, after its key and hash,
+		/// so a writer can insert while readers probe. Its owner replaces it by a larger one once half full.
+		/// @tparam Key The key type. Must be default constructible, copyable and equality comparable.
+		/// @tparam Value The type of the values the table points to.
+		template <typename Key, typename Value> class KeyTable final : public Reclaimable
+		{
+		  public:
+			/// @brief Smallest capacity of a table.
+			static constexpr std::size_t MinCapacity = 16;
+
+		  public:
+			explicit KeyTable(std::size_t capacity) : m_mask(capacity - 1), m_buckets(std::make_unique<Bucket[]>(capacity)) {}
+
+			/// @brief Returns the smallest capacity keeping a table holding the given number of keys at most a quarter full.
+			static std::size_t CapacityFor(std::size_t keyCount) noexcept
+			{
+				std::size_t capacity = MinCapacity;
+				while (capacity < 4 * keyCount)
+				{
+					capacity *= 2;
+				}
+				return capacity;
+			}
+
+			/// @brief Returns the value of a key, or nullptr if the key is not in the table.
+			Value* Find(const Key& key, std::size_t hash) const
+			{
+				for (std::size_t index = hash & m_mask;; index = (index + 1) & m_mask)
+				{
+					const Bucket& bucket = m_buckets[index];
+					Value* value = bucket.value.load(std::memory_order_acquire);
+					if (!value)
+					{
+						return nullptr;
+					}
+					if (bucket.hash == hash && bucket.key == key)
+					{
+						return value;
+					}
+				}
+			}
+
+			/// @brief Returns true if inserting one more key would make the table more than half full. Writers only.
+			bool IsFull() const noexcept { return 2 * (m_size + 1) > m_mask + 1; }
+
+			/// @brief Inserts a key that is not in the table yet. The table must not be full. Writers must be serialized.
+			void Insert(const Key& key, std::size_t hash, Value* value)
+			{
+				std::size_t index = hash & m_mask;
+				while (m_buckets[index].value.load(std::memory_order_relaxed))
+				{
+					index = (index + 1) & m_mask;
+				}
+
+				Bucket& bucket = m_buckets[index];
+				bucket.key = key;
+				bucket.hash = hash;
+				bucket.value.store(value, std::memory_order_release);
+				++m_size;
+			}
+
+		  private:
+			struct Bucket
+			{
+				/// @brief Value of the key, null while the bucket is empty.
+				std::atomic<Value*> value{nullptr};
+
+				/// @brief Hash of the key, compared before the key itself.
+				std::size_t hash = 0;
+
+				Key key{};
+			};
+
+			/// @brief Capacity minus one. The capacity is a power of two.
+			std::size_t m_mask;
+
+			/// @brief Number of keys. Writers only.
+			std::size_t m_size = 0;
+
+			std::unique_ptr<Bucket[]> m_buckets;
+		};
+
+		/// @brief Keys of an event and the record of each, found through a KeyTable that is replaced by a larger one once half full.
+		/// Records are allocated once, kept in insertion order, and only destroyed with the index, so tables and subscriptions can
+		/// point to them. Writers are serialized by the mutex of the owner.
+		/// @tparam Key The key type. Must be default constructible, copyable, equality comparable and hashable with std::hash.
+		/// @tparam Value The type of the record of a key. Must be default constructible.
+		/// @tparam Concurrent True if readers may look keys up from other threads, under an EpochGuard.
+		template <typename Key, typename Value, bool Concurrent> class KeyIndex
+		{
+		  public:
+			using Table = KeyTable<Key, Value>;
+
+		  public:
+			/// @brief Returns the record of a key, or nullptr if the key was never added. Readers must hold a ReadGuard, writers the mutex.
+			Value* Find(const Key& key, std::size_t hash) const
+			{
+				const Table* table = m_table.Get();
+				return table ? table->Find(key, hash) : nullptr;
+			}
+
+			/// @brief Returns the record of a key, adding it if needed. Must be called with the mutex held.
+			/// @param previous Set to the replaced table if the table grew, to be released once the mutex is unlocked.
+			Value& FindOrAdd(const Key& key, std::size_t hash, Retired<Table>& previous)
+			{
+				Table* table = m_table.Get();
+				if (table)
+				{
+					if (Value* value = table->Find(key, hash))
+					{
+						return *value;
+					}
+				}
+
+				if (!table || table->IsFull())
+				{
+					previous = Rehash(m_values.size() + 1);
+					table = m_table.Get();
+				}
+
+				m_values.reserve(m_values.size() + 1);
+				m_keys.reserve(m_keys.size() + 1);
+				m_values.push_back(std::make_unique<Value>());
+				try
+				{
+					m_keys.push_back(key);
+					table->Insert(key, hash, m_values.back().get());
+				}
+				catch (...)
+				{
+					if (m_keys.size() == m_values.size())
+					{
+						m_keys.pop_back();
+					}
+					m_values.pop_back();
+					throw;
+				}
+				return *m_values.back();
+			}
+
+			/// @brief Number of keys added so far. Must be called with the mutex held.
+			std::size_t Size() const noexcept { return m_values.size(); }
+
+			/// @brief Returns the record of the key added at the given position. Must be called with the mutex held.
+			Value& At(std::size_t index) const noexcept { return *m_values[index]; }
+
+		  private:
+			/// @brief Builds a table holding every key, with room for the given number of keys, then publishes it.
+			/// Must be called with the mutex held.
+			/// @return The previous table, to be released once the mutex is unlocked.
+			Retired<Table> Rehash(std::size_t keyCount)
+			{
+				std::unique_ptr<Table> table = std::make_unique<Table>(Table::CapacityFor(keyCount));
+				for (std::size_t i = 0; i < m_values.size(); ++i)
+				{
+					table->Insert(m_keys[i], HashKey(m_keys[i]), m_values[i].get());
+				}
+				return m_table.Exchange(std::move(table));
+			}
+
+		  private:
+			/// @brief Current table. Readers load it under an EpochGuard; replaced tables are retired to the epoch domain.
+			Publication<Table, Concurrent> m_table;
+
+			/// @brief Record of each key, in insertion order.
+			std::vector<std::unique_ptr<Value>> m_values;
+
+			/// @brief Key of each record, used to rehash.
+			std::vector<Key> m_keys;
+		};
+	} // namespace detail
+} // namespace onion
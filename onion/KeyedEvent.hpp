@@ -0,0 +1,411 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <onion/Epoch.hpp>
+#include <onion/Event.hpp>
+#include <onion/HandlerList.hpp>
+#include <onion/KeyTable.hpp>
+
+namespace onion
+{
+	/// @brief Event whose subscribers register for a key and only receive the events triggered for that key.
+	/// Each key has its own handlers list, found through an open-addressing hash table, so Trigger costs a lookup plus the
+	/// handlers of that key only. Every key shares the slot registry and the writers mutex of the event, so a key only costs its
+	/// bucket, a small record and its list, which starts with room for a few handlers and grows as they subscribe.
+	/// Keys are never removed: the record of a key stays allocated until the event is destroyed.
+	/// Handlers may subscribe, unsubscribe, clear or trigger the event they are invoked by. An unsubscribed handler is never invoked
+	/// again, even by the Trigger in progress, and a handler subscribed during a Trigger is not invoked by that Trigger.
+	/// Use the KeyedEvent alias rather than this class directly.
+	/// @tparam ThreadingPolicy How writers are serialized and how the lists are published: MultiThreaded, SpinLocked or SingleThreaded.
+	/// @tparam HandlerCapacity The size, in bytes, of the inline storage of each handler.
+	/// @tparam Key The key type. Must be default constructible, copyable, equality comparable and hashable with std::hash.
+	/// @tparam Args The types of the arguments passed to handlers when the event is triggered.
+	template <typename ThreadingPolicy, std::size_t HandlerCapacity, typename Key, typename... Args> class BasicKeyedEvent
+	{
+	  public:
+		/// @brief Type in which handlers are stored. Handlers live inline in the handlers list of their key and never allocate.
+		using Handler = InlineFunction<void(detail::EventParameter<Args>...), HandlerCapacity>;
+
+	  public:
+		BasicKeyedEvent() : m_core(new Core()) {}
+		BasicKeyedEvent(const BasicKeyedEvent&) = delete;
+		BasicKeyedEvent& operator=(const BasicKeyedEvent&) = delete;
+
+		/// @brief Destroys the handlers. Outstanding EventHandles stay valid and become inert.
+		~BasicKeyedEvent()
+		{
+			Clear();
+			if (m_core->IsDispatching())
+			{
+				// Destroyed by a handler: the outermost Trigger drops the reference of the event once it returns
+				m_core->orphaned = true;
+				return;
+			}
+			m_core->ReleaseRef();
+		}
+
+		/// @brief Subscribes a handler to the events triggered for a key.
+		/// @param key The key whose events the handler receives.
+		/// @param handler The handler function to be invoked when the event is triggered for the key.
+		/// @param priority The priority of the handler among the handlers of the key. Handlers of a higher priority are invoked first.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle.
+		template <typename Callable>
+			requires std::is_invocable_v<std::decay_t<Callable>&, detail::EventParameter<Args>...>
+		[[nodiscard]] EventHandle Subscribe(const Key& key, Callable&& handler, int priority = 0)
+		{
+			return Add(key, Handler(std::forward<Callable>(handler)), priority);
+		}
+
+		/// @brief Subscribes a member function of an object to the events triggered for a key. The object must outlive the subscription.
+		/// @tparam Method The member function to invoke, e.g. &MyClass::OnEvent.
+		/// @param key The key whose events the handler receives.
+		/// @param instance The object on which the member function is invoked.
+		/// @param priority The priority of the handler among the handlers of the key. Handlers of a higher priority are invoked first.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle.
+		template <auto Method, typename Class>
+			requires std::is_member_function_pointer_v<decltype(Method)> &&
+					 std::is_invocable_v<decltype(Method), Class&, detail::EventParameter<Args>...>
+		[[nodiscard]] EventHandle Subscribe(const Key& key, Class& instance, int priority = 0)
+		{
+			return Subscribe(key, detail::MemberDelegate<Method, Class>{&instance}, priority);
+		}
+
+		/// @brief Unsubscribes a handle from the events of its key. Destroying the last copy of the handle has the same effect.
+		/// Runs in constant time: the slot of the handle records the key it was subscribed to, so no lookup is needed.
+		/// @param eventHandle The EventHandle representing the subscription to be removed.
+		void Unsubscribe(const EventHandle& eventHandle)
+		{
+			if (eventHandle.m_registry != m_core)
+			{
+				return;
+			}
+
+			detail::Retired<HandlerList> previous;
+			std::lock_guard<Mutex> lock(m_core->Mutex());
+			if (m_core->Expire(*eventHandle.m_slot, eventHandle.m_generation))
+			{
+				previous = m_core->OnExpired(*static_cast<KeyEntry*>(eventHandle.m_slot->owner));
+			}
+		}
+
+		/// @brief Triggers the event for a key, invoking the handlers subscribed to that key only. Invokes handlers in the same thread
+		/// that calls this method. Does nothing if no handler was ever subscribed to the key.
+		/// @param key The key of the event.
+		/// @param args The event arguments to be passed to each handler of the key.
+		void Trigger(const Key& key, detail::EventParameter<Args>... args) const
+		{
+			if constexpr (!ThreadingPolicy::IsConcurrent)
+			{
+				// Lists replaced while dispatching are kept until the outermost Trigger returns, so the list is used in place
+				const DispatchScope scope(*m_core);
+				if (const HandlerList* handlers = FindHandlers(key))
+				{
+					handlers->ForEachLive([&args...](const Handler& handler) { handler(args...); });
+				}
+				return;
+			}
+
+			// Pin the epoch without taking the mutex, so the table and the list of the key are not destroyed while they are used even
+			// if they are replaced; handlers subscribed after this point are not visible to this call
+			const detail::EpochGuard guard;
+			if (const HandlerList* handlers = FindHandlers(key))
+			{
+				handlers->ForEachLive([&args...](const Handler& handler) { handler(args...); });
+			}
+		}
+
+		/// @brief Clears the handlers of every key, effectively unsubscribing all subscribers. The keys are kept.
+		/// Keys are cleared one at a time, so a subscription made meanwhile to a key already cleared is kept.
+		void Clear()
+		{
+			for (std::size_t i = 0;; ++i)
+			{
+				// The list of the key is released once the mutex is unlocked, as destroying handlers may release handles
+				detail::Retired<HandlerList> previous;
+				std::lock_guard<Mutex> lock(m_core->Mutex());
+				if (i == m_core->keys.Size())
+				{
+					return;
+				}
+				previous = m_core->ClearKey(m_core->keys.At(i));
+			}
+		}
+
+		/// @brief Returns the number of keys a handler was ever subscribed to.
+		std::size_t KeyCount() const
+		{
+			std::lock_guard<Mutex> lock(m_core->Mutex());
+			return m_core->keys.Size();
+		}
+
+		/// @brief Returns the number of handlers of alive subscriptions to a key.
+		std::size_t LiveHandlerCount(const Key& key) const
+		{
+			std::lock_guard<Mutex> lock(m_core->Mutex());
+			const KeyEntry* entry = m_core->keys.Find(key, detail::HashKey(key));
+			const HandlerList* handlers = entry ? entry->handlers.Get() : nullptr;
+			return handlers ? handlers->Size() - entry->expiredHandlers : 0;
+		}
+
+	  private:
+		using Mutex = typename ThreadingPolicy::Mutex;
+
+		/// @brief Handlers list of a key. Keyed handlers are never batch subscribers.
+		using HandlerList = detail::HandlerList<Handler, void (*)()>;
+
+		/// @brief Handler about to be inserted in the list of a key.
+		using PendingHandler = typename HandlerList::Entry;
+
+		/// @brief Record of a key, referred to by the key tables and by the slots of its subscriptions.
+		struct KeyEntry
+		{
+			/// @brief Current handlers list of the key, null until its first subscription and after Clear.
+			detail::Publication<HandlerList, ThreadingPolicy::IsConcurrent> handlers;
+
+			/// @brief Ended subscriptions whose handler is still in the list, waiting to be swept. Guarded by the mutex.
+			std::size_t expiredHandlers = 0;
+		};
+
+		/// @brief Keys of the event and their record.
+		using KeyIndex = detail::KeyIndex<Key, KeyEntry, ThreadingPolicy::IsConcurrent>;
+
+		/// @brief Shared state of the event: the slot registry, the writers mutex and the record of every key.
+		/// It outlives the event while EventHandles refer to it.
+		struct Core final : detail::LockedSubscriptionRegistry<Mutex>
+		{
+			/// @brief Smallest capacity of the list of a key. Most keys have a handful of subscribers.
+			static constexpr std::size_t MinCapacity = 4;
+
+			/// @brief Record of each key. Records are only destroyed with the core, so the slots can refer to them. Trigger looks keys
+			/// up under an EpochGuard, without the mutex.
+			KeyIndex keys;
+
+			/// @brief When to sweep the expired handlers of a key.
+			ReclamationPolicy reclamation;
+
+			/// @brief Number of nested Trigger calls in progress. Only counted by single-threaded events.
+			std::size_t dispatchDepth = 0;
+
+			/// @brief Lists replaced while dispatching, which a Trigger in progress may be using. Single-threaded events only.
+			std::vector<detail::Retired<HandlerList>> replacedLists;
+
+			/// @brief True once the event was destroyed by one of its handlers, so the outermost Trigger drops the reference of the
+			/// event when it returns. Single-threaded events only.
+			bool orphaned = false;
+
+			/// @brief Returns true if a single-threaded event is dispatching, so replaced lists must be kept.
+			bool IsDispatching() const noexcept
+			{
+				if constexpr (ThreadingPolicy::IsConcurrent)
+				{
+					return false;
+				}
+				return dispatchDepth > 0;
+			}
+
+			/// @brief Makes room for the given number of lists in replacedLists if dispatching, so replacing them never fails.
+			/// Must be called with the mutex held, before replacing any list.
+			void ReserveReplacedLists(std::size_t count)
+			{
+				if (IsDispatching())
+				{
+					replacedLists.reserve(replacedLists.size() + count);
+				}
+			}
+
+			/// @brief Replaces the list of a key. Must be called with the mutex held, after ReserveReplacedLists.
+			/// @return The previous list, to be released once the mutex is unlocked, or null if a Trigger in progress keeps it.
+			detail::Retired<HandlerList> Publish(KeyEntry& entry, std::unique_ptr<HandlerList> next) noexcept
+			{
+				detail::Retired<HandlerList> previous = HandlerList::Publish(entry.handlers, std::move(next));
+				if (previous && IsDispatching())
+				{
+					replacedLists.push_back(std::move(previous));
+				}
+				return previous;
+			}
+
+			/// @brief Inserts a handler after the handlers of the key of the same or a higher priority. It is appended in place when
+			/// that keeps the priority order, otherwise the list is rebuilt with the handler at its position. Must be called with the
+			/// mutex held, after ReserveReplacedLists.
+			/// @return The previous list if it was replaced, to be released once the mutex is unlocked.
+			detail::Retired<HandlerList> Insert(KeyEntry& entry, PendingHandler& pending)
+			{
+				HandlerList* current = entry.handlers.Get();
+				if (current && current->CanAppend(pending.binding.priority) && !ShouldSweep(entry, *current))
+				{
+					current->Append(pending.binding, std::move(pending.handler));
+					current->BindSlot(current->Size() - 1);
+					return nullptr;
+				}
+				return Sweep(entry, &pending);
+			}
+
+			/// @brief Returns true if the reclamation policy asks for a sweep of the list of a key. Must be called with the mutex held.
+			bool ShouldSweep(const KeyEntry& entry, const HandlerList& list) const noexcept
+			{
+				return entry.expiredHandlers >= reclamation.minExpiredHandlers &&
+					   static_cast<double>(entry.expiredHandlers) >= reclamation.minExpiredRatio * static_cast<double>(list.Size());
+			}
+
+			/// @brief Publishes a new list of a key holding only its live handlers, with room to grow. Must be called with the mutex
+			/// held, after ReserveReplacedLists.
+			/// @param insertion Handler to copy into the new list at its priority position, if any.
+			/// @return The previous list, to be released once the mutex is unlocked.
+			detail::Retired<HandlerList> Sweep(KeyEntry& entry, const PendingHandler* insertion = nullptr)
+			{
+				const HandlerList* current = entry.handlers.Get();
+				const std::size_t size = current ? current->Size() : 0;
+				const std::size_t capacity = 2 * (size - entry.expiredHandlers + (insertion ? 1 : 0));
+				std::unique_ptr<HandlerList> next = HandlerList::Rebuild(current, capacity > MinCapacity ? capacity : MinCapacity, insertion);
+
+				const std::size_t swept = size - (next->Size() - (insertion ? 1 : 0));
+				entry.expiredHandlers -= swept;
+				this->ForgetExpiredHandlers(swept);
+
+				// Copying a handler may throw: the slots keep pointing into the current list until nothing can fail anymore
+				next->BindSlots();
+				return Publish(entry, std::move(next));
+			}
+
+			/// @brief Counts an ended subscription of a key, then sweeps the key if the reclamation policy asks for it.
+			/// Must be called with the mutex held, after the subscription expired.
+			/// @return The previous list if a sweep happened, to be released once the mutex is unlocked.
+			detail::Retired<HandlerList> OnExpired(KeyEntry& entry)
+			{
+				++entry.expiredHandlers;
+
+				// Checked again by the next expiry or subscription of the key, since no room is reserved to keep the list
+				const HandlerList* current = entry.handlers.Get();
+				if (!IsDispatching() && current && ShouldSweep(entry, *current))
+				{
+					return Sweep(entry);
+				}
+				return nullptr;
+			}
+
+			/// @brief Ends every subscription of a key and drops its list, unless a single-threaded event is dispatching: the list is
+			/// then swept by the next expiry or subscription of the key, or with the core. Must be called with the mutex held.
+			/// @return The previous list, to be released once the mutex is unlocked.
+			detail::Retired<HandlerList> ClearKey(KeyEntry& entry) noexcept
+			{
+				const HandlerList* current = entry.handlers.Get();
+				if (!current)
+				{
+					return nullptr;
+				}
+
+				const std::size_t size = current->Size();
+				for (std::size_t i = 0; i < size; ++i)
+				{
+					const typename HandlerList::Binding& binding = current->BindingAt(i);
+					this->Expire(*binding.slot, binding.generation);
+				}
+				if (IsDispatching())
+				{
+					entry.expiredHandlers = size;
+					return nullptr;
+				}
+				this->ForgetExpiredHandlers(size);
+				entry.expiredHandlers = 0;
+				return Publish(entry, nullptr);
+			}
+
+		  protected:
+			detail::Retired<detail::Reclaimable> OnSubscriptionExpired(detail::SubscriptionSlot& slot) noexcept override
+			{
+				KeyEntry& entry = *static_cast<KeyEntry*>(slot.owner);
+				try
+				{
+					return OnExpired(entry);
+				}
+				catch (...)
+				{
+					// Sweeping is an optimization: on failure, expired handlers are simply kept until the next sweep
+					return nullptr;
+				}
+			}
+		};
+
+		/// @brief Counts a Trigger of a single-threaded event as dispatching, and releases the lists replaced meanwhile when the
+		/// outermost one returns. The shared state keeps them; a handler destroying the event leaves it orphaned instead of
+		/// releasing it, so the Trigger keeps it alive without touching the reference count.
+		class DispatchScope
+		{
+		  public:
+			explicit DispatchScope(Core& core) noexcept : m_core(core) { ++m_core.dispatchDepth; }
+			DispatchScope(const DispatchScope&) = delete;
+			DispatchScope& operator=(const DispatchScope&) = delete;
+
+			~DispatchScope()
+			{
+				if (--m_core.dispatchDepth > 0)
+				{
+					return;
+				}
+				{
+					// Destroying handlers may release handles, which must not find the lists being destroyed
+					std::vector<detail::Retired<HandlerList>> replaced;
+					replaced.swap(m_core.replacedLists);
+				}
+				if (m_core.orphaned)
+				{
+					m_core.ReleaseRef();
+				}
+			}
+
+		  private:
+			Core& m_core;
+		};
+
+		/// @brief Returns the current list of a key, or nullptr if it has no handlers. Readers must hold a ReadGuard or a DispatchScope.
+		const HandlerList* FindHandlers(const Key& key) const
+		{
+			const KeyEntry* entry = m_core->keys.Find(key, detail::HashKey(key));
+			return entry ? entry->handlers.Get() : nullptr;
+		}
+
+		/// @brief Subscribes a stored handler to a key, at its priority position.
+		EventHandle Add(const Key& key, Handler&& handler, int priority)
+		{
+			// Replaced tables and lists are released once the mutex is unlocked, as destroying handlers may release handles
+			detail::Retired<typename KeyIndex::Table> previousTable;
+			detail::Retired<HandlerList> previous;
+			std::lock_guard<Mutex> lock(m_core->Mutex());
+
+			KeyEntry& entry = m_core->keys.FindOrAdd(key, detail::HashKey(key), previousTable);
+			m_core->ReserveReplacedLists(1);
+			detail::SubscriptionSlot* slot = m_core->AcquireSlot();
+			const std::uint32_t generation = slot->generation.load(std::memory_order_relaxed);
+			slot->owner = &entry;
+			PendingHandler pending{{slot, generation, nullptr, priority}, std::move(handler)};
+			try
+			{
+				previous = m_core->Insert(entry, pending);
+			}
+			catch (...)
+			{
+				m_core->AbandonSlot(*slot);
+				throw;
+			}
+
+			return EventHandle(m_core, slot, generation);
+		}
+
+	  private:
+		/// @brief Shared state of the event, referenced by the EventHandles it issued.
+		Core* m_core;
+	};
+
+	/// @brief Keyed event usable from any thread. Writers are serialized on a std::mutex, Trigger never locks.
+	/// Use BasicKeyedEvent directly to choose another threading policy or handler capacity.
+	template <typename Key, typename... Args>
+	using KeyedEvent = BasicKeyedEvent<MultiThreaded, DefaultInlineFunctionCapacity, Key, Args...>;
+} // namespace onion
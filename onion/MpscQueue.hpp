@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace onion
+{
+	namespace detail
+	{
+		/// @brief Unbounded lock-free queue with any number of producers and a single consumer. Pushing allocates a node and links it
+		/// with a single atomic exchange, so producers never wait for each other nor for the consumer. Values are popped in the order
+		/// their exchange happened.
+		/// @tparam T The type of the queued values.
+		template <typename T> class MpscQueue
+		{
+		  public:
+			MpscQueue() noexcept : m_head(&m_stub), m_tail(&m_stub) {}
+			MpscQueue(const MpscQueue&) = delete;
+			MpscQueue& operator=(const MpscQueue&) = delete;
+
+			/// @brief Destroys the values still queued. No producer may be pushing.
+			~MpscQueue()
+			{
+				while (TryPop())
+				{
+				}
+				if (m_tail != &m_stub)
+				{
+					delete m_tail;
+				}
+			}
+
+			/// @brief Constructs a value at the back of the queue. Safe to call from any thread.
+			template <typename... Values> void Push(Values&&... values)
+			{
+				Node* node = new Node(std::in_place, std::forward<Values>(values)...);
+				Node* previous = m_head.exchange(node, std::memory_order_acq_rel);
+				previous->next.store(node, std::memory_order_release);
+			}
+
+			/// @brief Pops the value at the front of the queue. Consumer only.
+			/// @return The value, or nothing if the queue is empty, or if the producer of the front value has not linked it yet.
+			std::optional<T> TryPop()
+			{
+				Node* tail = m_tail;
+				Node* next = tail->next.load(std::memory_order_acquire);
+				if (!next)
+				{
+					return std::nullopt;
+				}
+
+				// The popped node becomes the new sentinel, and the previous sentinel is freed
+				std::optional<T> value(std::move(next->value));
+				next->value.reset();
+				m_tail = next;
+				if (tail != &m_stub)
+				{
+					delete tail;
+				}
+				return value;
+			}
+
+		  private:
+			struct Node
+			{
+				Node() = default;
+
+				template <typename... Values>
+				explicit Node(std::in_place_t, Values&&... values) : value(std::in_place, std::forward<Values>(values)...)
+				{
+				}
+
+				std::atomic<Node*> next{nullptr};
+				std::optional<T> value;
+			};
+
+			/// @brief Last pushed node. Producers exchange it.
+			std::atomic<Node*> m_head;
+
+			/// @brief Sentinel preceding the front value. Consumer only.
+			Node* m_tail;
+
+			/// @brief Initial sentinel, so the queue never allocates until a value is pushed.
+			Node m_stub;
+		};
+	} // namespace detail
+} // namespace onion
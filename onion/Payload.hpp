@@ -0,0 +1,254 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include <onion/ThreadingPolicy.hpp>
+
+namespace onion
+{
+	template <typename T> class PayloadPool;
+
+	namespace detail
+	{
+		template <typename T> class PayloadPoolState;
+
+		/// @brief Storage of a payload, recycled by its pool. The payload is constructed in place and destroyed with its last reference.
+		template <typename T> struct PayloadBlock
+		{
+			/// @brief Number of Payload handles referring to the block.
+			std::atomic<std::uint32_t> references{0};
+
+			/// @brief Pool the block returns to.
+			PayloadPoolState<T>* pool = nullptr;
+
+			/// @brief Next cached block, while the block is free. Guarded by the pool mutex.
+			PayloadBlock* nextFree = nullptr;
+
+			alignas(T) std::byte storage[sizeof(T)];
+
+			T& Value() noexcept { return *std::launder(reinterpret_cast<T*>(storage)); }
+		};
+
+		/// @brief Free list of a PayloadPool. It is reference counted by the pool and by every block in use, so payloads can outlive
+		/// their pool.
+		template <typename T> class PayloadPoolState
+		{
+		  public:
+			explicit PayloadPoolState(std::size_t maxCached) noexcept : m_maxCached(maxCached) {}
+
+			/// @brief Takes a block from the free list, or allocates one. The block references the pool until it is recycled.
+			PayloadBlock<T>* Acquire()
+			{
+				m_references.fetch_add(1, std::memory_order_relaxed);
+				{
+					std::lock_guard<SpinMutex> lock(m_mutex);
+					if (PayloadBlock<T>* block = m_free)
+					{
+						m_free = block->nextFree;
+						--m_cached;
+						return block;
+					}
+				}
+
+				try
+				{
+					PayloadBlock<T>* block = new PayloadBlock<T>();
+					block->pool = this;
+					return block;
+				}
+				catch (...)
+				{
+					ReleaseRef();
+					throw;
+				}
+			}
+
+			/// @brief Returns a block whose payload was destroyed to the free list, or frees it if the list is full or the pool is gone.
+			void Recycle(PayloadBlock<T>* block) noexcept
+			{
+				{
+					std::lock_guard<SpinMutex> lock(m_mutex);
+					if (!m_closed && m_cached < m_maxCached)
+					{
+						block->nextFree = m_free;
+						m_free = block;
+						++m_cached;
+						block = nullptr;
+					}
+				}
+				delete block;
+				ReleaseRef();
+			}
+
+			/// @brief Frees the cached blocks and drops the reference of the pool. Blocks in use are freed when recycled.
+			void Close() noexcept
+			{
+				PayloadBlock<T>* free;
+				{
+					std::lock_guard<SpinMutex> lock(m_mutex);
+					m_closed = true;
+					free = std::exchange(m_free, nullptr);
+					m_cached = 0;
+				}
+				while (free)
+				{
+					delete std::exchange(free, free->nextFree);
+				}
+				ReleaseRef();
+			}
+
+		  private:
+			void ReleaseRef() noexcept
+			{
+				if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					delete this;
+				}
+			}
+
+		  private:
+			/// @brief References held by the pool and by the blocks in use.
+			std::atomic<std::size_t> m_references{1};
+
+			/// @brief Guards the members below.
+			SpinMutex m_mutex;
+
+			/// @brief Cached free blocks.
+			PayloadBlock<T>* m_free = nullptr;
+
+			/// @brief Number of cached free blocks.
+			std::size_t m_cached = 0;
+
+			/// @brief Maximum number of cached free blocks.
+			const std::size_t m_maxCached;
+
+			/// @brief Set once the pool is destroyed.
+			bool m_closed = false;
+		};
+	} // namespace detail
+
+	/// @brief Shared, immutable event argument: a reference-counted handle to a value built once in storage recycled by a
+	/// PayloadPool. Copying a payload only increments its reference count, so an event carrying a Payload<T> hands the same value
+	/// to every subscriber, including through TriggerAsync, Post, dispatchers and the other queued deliveries, without copying it.
+	/// It converts to const T&, so handlers can take the value itself.
+	/// @tparam T The type of the value.
+	template <typename T> class Payload
+	{
+	  public:
+		Payload() = default;
+
+		Payload(const Payload& other) noexcept : m_block(other.m_block)
+		{
+			if (m_block)
+			{
+				m_block->references.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		Payload(Payload&& other) noexcept : m_block(std::exchange(other.m_block, nullptr)) {}
+
+		Payload& operator=(const Payload& other) noexcept
+		{
+			Payload copy(other);
+			std::swap(m_block, copy.m_block);
+			return *this;
+		}
+
+		Payload& operator=(Payload&& other) noexcept
+		{
+			Payload moved(std::move(other));
+			std::swap(m_block, moved.m_block);
+			return *this;
+		}
+
+		/// @brief Drops the reference. The last one destroys the value and returns its storage to the pool.
+		~Payload()
+		{
+			if (m_block && m_block->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				m_block->Value().~T();
+				m_block->pool->Recycle(m_block);
+			}
+		}
+
+		/// @brief Returns true if the payload holds a value, false if it is default constructed or moved from.
+		explicit operator bool() const noexcept { return m_block != nullptr; }
+
+		/// @brief Returns the value. The payload must not be empty.
+		const T& Get() const noexcept { return m_block->Value(); }
+		const T& operator*() const noexcept { return Get(); }
+		const T* operator->() const noexcept { return &Get(); }
+
+		/// @brief Returns the value, so handlers of an event carrying payloads can take a const T&.
+		operator const T&() const noexcept { return Get(); } // NOLINT(google-explicit-constructor)
+
+	  private:
+		friend class PayloadPool<T>;
+
+		/// @brief Adopts the first reference to a block holding a value.
+		explicit Payload(detail::PayloadBlock<T>* block) noexcept : m_block(block) {}
+
+	  private:
+		detail::PayloadBlock<T>* m_block = nullptr;
+	};
+
+	/// @brief Recycles the storage of payloads of type T: once the last reference to a payload is dropped, its storage returns
+	/// to the pool and the next Make reuses it, so a steady flow of events allocates nothing. Safe to use from any thread.
+	/// Payloads may outlive their pool.
+	/// @tparam T The type of the values.
+	template <typename T> class PayloadPool
+	{
+	  public:
+		/// @brief Creates an empty pool.
+		/// @param maxCached The maximum number of free blocks kept for reuse; blocks returned beyond it are freed.
+		explicit PayloadPool(std::size_t maxCached = DefaultMaxCached) : m_state(new detail::PayloadPoolState<T>(maxCached)) {}
+
+		PayloadPool(const PayloadPool&) = delete;
+		PayloadPool& operator=(const PayloadPool&) = delete;
+
+		~PayloadPool() { m_state->Close(); }
+
+		/// @brief Returns the pool used by MakePayload.
+		static PayloadPool& Shared()
+		{
+			static PayloadPool pool;
+			return pool;
+		}
+
+		/// @brief Builds a value in recycled storage.
+		/// @param values The arguments of the constructor of T.
+		/// @return The only reference to the value.
+		template <typename... Values> Payload<T> Make(Values&&... values)
+		{
+			detail::PayloadBlock<T>* block = m_state->Acquire();
+			try
+			{
+				::new (static_cast<void*>(block->storage)) T(std::forward<Values>(values)...);
+			}
+			catch (...)
+			{
+				m_state->Recycle(block);
+				throw;
+			}
+			block->references.store(1, std::memory_order_relaxed);
+			return Payload<T>(block);
+		}
+
+	  private:
+		static constexpr std::size_t DefaultMaxCached = 64;
+
+		/// @brief Free list, shared with the blocks in use.
+		detail::PayloadPoolState<T>* m_state;
+	};
+
+	/// @brief Builds a payload in storage recycled by the shared pool of T, e.g. event.TriggerAsync(onion::MakePayload<Snapshot>(book)).
+	template <typename T, typename... Values> Payload<T> MakePayload(Values&&... values)
+	{
+		return PayloadPool<T>::Shared().Make(std::forward<Values>(values)...);
+	}
+} // namespace onion
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <onion/Event.hpp>
+
+namespace onion
+{
+	/// @brief Event remembering the arguments of its last triggers in a preallocated ring buffer, and replaying them to each new
+	/// subscriber before it receives the live events. The replay and the subscription are atomic with respect to Trigger:
+	/// a new subscriber receives every event exactly once, either replayed or live, in trigger order.
+	/// A handler subscribed by a handler of a single-threaded event only takes effect once the outermost Trigger returns: the
+	/// events triggered meanwhile are replayed to it right before the next event it receives, unless they were overwritten in
+	/// the ring buffer since. Trigger records the event under the writers mutex, then dispatches it without the mutex, like any event.
+	/// Use the ReplayEvent alias rather than this class directly.
+	/// @tparam ThreadingPolicy How writers are serialized and how the handlers list is published: MultiThreaded, SpinLocked or SingleThreaded.
+	/// @tparam HandlerCapacity The size, in bytes, of the inline storage of each handler.
+	/// @tparam ReplayCount The number of events replayed to new subscribers.
+	/// @tparam Args The types of the arguments passed to handlers when the event is triggered.
+	template <typename ThreadingPolicy, std::size_t HandlerCapacity, std::size_t ReplayCount, typename... Args> class BasicReplayEvent
+	{
+		static_assert(ReplayCount > 0, "A replay event must remember at least one event");
+
+		/// @brief Trigger in progress, passed to the handlers along with the arguments.
+		struct Dispatch
+		{
+			/// @brief Sequence number of the event.
+			std::uint64_t sequence;
+
+			/// @brief The triggered event, null once it was destroyed by a handler.
+			const BasicReplayEvent* event;
+
+			/// @brief Trigger this one is nested in, tracked for single-threaded events only.
+			Dispatch* outer;
+		};
+
+	  public:
+		/// @brief Event invoking the handlers with the trigger in progress, so they can skip the events they were replayed.
+		using SequencedEvent = BasicEvent<ThreadingPolicy, HandlerCapacity + 2 * sizeof(std::uint64_t), Dispatch, Args...>;
+
+	  public:
+		BasicReplayEvent() = default;
+		BasicReplayEvent(const BasicReplayEvent&) = delete;
+		BasicReplayEvent& operator=(const BasicReplayEvent&) = delete;
+
+		~BasicReplayEvent()
+		{
+			// The triggers still dispatching must not replay from the destroyed history
+			for (Dispatch* dispatch = m_dispatch; dispatch; dispatch = dispatch->outer)
+			{
+				dispatch->event = nullptr;
+			}
+		}
+
+		/// @brief Subscribes a handler to the event, after invoking it with the remembered events, oldest first, on the calling thread.
+		/// Triggers wait while the events are replayed, so the handler must not trigger nor subscribe to this event when replayed.
+		/// If the handler throws while replayed, it is not subscribed.
+		/// @param handler The handler function to be invoked with the remembered events, then when the event is triggered.
+		/// @param priority The priority of the handler. Handlers of a higher priority are invoked first.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle.
+		template <typename Callable>
+			requires std::is_invocable_v<std::decay_t<Callable>&, detail::EventParameter<Args>...>
+		[[nodiscard]] EventHandle Subscribe(Callable&& handler, int priority = 0)
+		{
+			std::decay_t<Callable> callable(std::forward<Callable>(handler));
+
+			std::lock_guard<Mutex> lock(m_mutex);
+			for (std::uint64_t index = m_sequence > ReplayCount ? m_sequence - ReplayCount : 0; index < m_sequence; ++index)
+			{
+				ReplayAt(callable, index);
+			}
+
+			// Only single-threaded events defer subscriptions made while dispatching
+			const bool late = m_dispatch != nullptr;
+			return m_event.Subscribe(Delegate<std::decay_t<Callable>>{std::move(callable), m_sequence, late}, priority);
+		}
+
+		/// @brief Subscribes a member function of an object to the event, after invoking it with the remembered events.
+		/// The object must outlive the subscription.
+		/// @tparam Method The member function to invoke, e.g. &MyClass::OnEvent.
+		/// @param instance The object on which the member function is invoked.
+		/// @param priority The priority of the handler. Handlers of a higher priority are invoked first.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle.
+		template <auto Method, typename Class>
+			requires std::is_member_function_pointer_v<decltype(Method)> &&
+					 std::is_invocable_v<decltype(Method), Class&, detail::EventParameter<Args>...>
+		[[nodiscard]] EventHandle Subscribe(Class& instance, int priority = 0)
+		{
+			return Subscribe(detail::MemberDelegate<Method, Class>{&instance}, priority);
+		}
+
+		/// @brief Unsubscribes a handle from the event. Destroying the last copy of the handle has the same effect.
+		/// @param eventHandle The EventHandle representing the subscription to be removed.
+		void Unsubscribe(const EventHandle& eventHandle) { m_event.Unsubscribe(eventHandle); }
+
+		/// @brief Remembers the event, overwriting the oldest one once ReplayCount events are remembered, then invokes the handlers
+		/// in the same thread that calls this method.
+		/// @param args The event arguments, copied into the ring buffer and passed to each handler.
+		void Trigger(detail::EventParameter<Args>... args)
+		{
+			Dispatch dispatch{0, this, nullptr};
+			{
+				std::lock_guard<Mutex> lock(m_mutex);
+				std::optional<RememberedEvent>& entry = m_history[m_sequence % ReplayCount];
+				if (entry)
+				{
+					*entry = std::forward_as_tuple(args...);
+				}
+				else
+				{
+					entry.emplace(args...);
+				}
+				dispatch.sequence = ++m_sequence;
+			}
+
+			if constexpr (ThreadingPolicy::IsConcurrent)
+			{
+				m_event.Trigger(dispatch, args...);
+			}
+			else
+			{
+				dispatch.outer = m_dispatch;
+				m_dispatch = &dispatch;
+				try
+				{
+					m_event.Trigger(dispatch, args...);
+				}
+				catch (...)
+				{
+					if (dispatch.event)
+					{
+						m_dispatch = dispatch.outer;
+					}
+					throw;
+				}
+
+				// A handler may have destroyed the event
+				if (dispatch.event)
+				{
+					m_dispatch = dispatch.outer;
+				}
+			}
+		}
+
+		/// @brief Clears all handlers from the event, effectively unsubscribing all subscribers. The remembered events are kept.
+		void Clear() { m_event.Clear(); }
+
+		/// @brief Returns the number of events replayed to a handler subscribing now.
+		std::size_t ReplaySize() const
+		{
+			std::lock_guard<Mutex> lock(m_mutex);
+			return m_sequence < ReplayCount ? static_cast<std::size_t>(m_sequence) : ReplayCount;
+		}
+
+	  private:
+		using Mutex = typename ThreadingPolicy::Mutex;
+
+		/// @brief Arguments of a remembered event.
+		using RememberedEvent = std::tuple<std::decay_t<Args>...>;
+
+		/// @brief Handler of a replay event: skips the events triggered before it was subscribed, which it received as a replay.
+		template <typename Callable> struct Delegate
+		{
+			mutable Callable callable;
+
+			/// @brief Sequence number of the last event replayed to the handler.
+			mutable std::uint64_t replayedUntil;
+
+			/// @brief True until the first live event if the handler was subscribed while a single-threaded event was dispatching,
+			/// and may have missed the events triggered before the subscription took effect.
+			mutable bool late;
+
+			void operator()(const Dispatch& dispatch, detail::EventParameter<Args>... args) const
+			{
+				if (dispatch.sequence <= replayedUntil)
+				{
+					return;
+				}
+				if (late)
+				{
+					// A nested trigger may reach the handler first: the outer one is then skipped, as it was replayed
+					late = false;
+					const std::uint64_t missedAfter = std::exchange(replayedUntil, dispatch.sequence - 1);
+					for (std::uint64_t index = missedAfter; index < replayedUntil && dispatch.event; ++index)
+					{
+						dispatch.event->ReplayAt(callable, index);
+					}
+					if (!dispatch.event)
+					{
+						// Destroyed while replaying, which ended the subscription
+						return;
+					}
+				}
+				callable(args...);
+			}
+		};
+
+		/// @brief Invokes a handler with the event of sequence number index + 1, if it is still remembered. Must be called with the
+		/// mutex held, or from the thread triggering a single-threaded event.
+		template <typename Callable> void ReplayAt(Callable& callable, std::uint64_t index) const
+		{
+			if (index + ReplayCount >= m_sequence)
+			{
+				std::apply(callable, *m_history[index % ReplayCount]);
+			}
+		}
+
+		/// @brief Serializes the recording of events with the replays.
+		mutable Mutex m_mutex;
+
+		/// @brief Number of triggers so far, which is the sequence number of the last event. Guarded by the mutex.
+		std::uint64_t m_sequence = 0;
+
+		/// @brief Last events, the one of sequence number n + 1 at index n % ReplayCount. Entries keep their storage once
+		/// overwritten. Guarded by the mutex.
+		std::array<std::optional<RememberedEvent>, ReplayCount> m_history;
+
+		/// @brief Innermost trigger dispatching, for single-threaded events only.
+		Dispatch* m_dispatch = nullptr;
+
+		/// @brief Event invoking the handlers.
+		SequencedEvent m_event;
+	};
+
+	/// @brief Replay event usable from any thread. Use BasicReplayEvent directly to choose another threading policy or handler capacity.
+	template <std::size_t ReplayCount, typename... Args>
+	using ReplayEvent = BasicReplayEvent<MultiThreaded, DefaultInlineFunctionCapacity, ReplayCount, Args...>;
+} // namespace onion
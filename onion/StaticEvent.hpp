@@ -0,0 +1,317 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <onion/EventHandle.hpp>
+#include <onion/InlineFunction.hpp>
+#include <onion/ThreadingPolicy.hpp>
+
+namespace onion
+{
+	/// @brief Fixed-capacity variant of Event that never touches the heap: handlers, their liveness bitset and the subscription slots
+	/// are all stored inline. Subscribe returns an empty EventHandle when the event is full.
+	/// It only offers the core of the Event API, for a single argument type. It has no priorities: handlers run in the order of their
+	/// entries, which are reused, so not necessarily in subscription order. It has no batch, asynchronous or posted triggers.
+	/// Unlike Event, a StaticEvent must outlive the EventHandles it issued, since the slots they refer to are stored in the event:
+	/// every handle must be destroyed, reset or moved from before the event is destroyed. Declare the event before the members or
+	/// the locals holding its handles, so they are destroyed first.
+	/// Use the StaticEvent alias rather than this class directly.
+	/// @tparam ThreadingPolicy How writers are serialized: MultiThreaded, SpinLocked or SingleThreaded.
+	/// @tparam HandlerCapacity The size, in bytes, of the inline storage of each handler. Subscribing a handler that does not fit fails to compile.
+	/// @tparam Capacity The maximum number of handlers, and of subscriptions whose handles are alive.
+	/// @tparam EventArgs The type of the event arguments that will be passed to handlers when the event is triggered.
+	template <typename ThreadingPolicy, std::size_t HandlerCapacity, std::size_t Capacity, typename EventArgs> class BasicStaticEvent
+	{
+		static_assert(Capacity > 0, "A StaticEvent needs room for at least one handler");
+
+	  public:
+		/// @brief Type in which handlers are stored.
+		using Handler = InlineFunction<void(const EventArgs&), HandlerCapacity>;
+
+	  public:
+		BasicStaticEvent() = default;
+		BasicStaticEvent(const BasicStaticEvent&) = delete;
+		BasicStaticEvent& operator=(const BasicStaticEvent&) = delete;
+
+		/// @brief Destroys the handlers. No Trigger may be running, and no EventHandle issued by the event may remain, since it
+		/// would refer to a destroyed slot.
+		~BasicStaticEvent()
+		{
+			Clear();
+			for (std::size_t index = 0; index < Capacity; ++index)
+			{
+				if (IsOccupied(index))
+				{
+					HandlerAt(index).~Handler();
+				}
+			}
+		}
+
+		/// @brief Subscribes a handler to the event. The handler will be invoked with the specified EventArgs when the event is triggered.
+		/// Fails when Capacity subscriptions still have alive handles, or when every handler entry is in use. An entry whose subscription
+		/// ended is reused once no Trigger is running.
+		/// @param handler The handler function to be invoked when the event is triggered. Its captures must fit in HandlerCapacity bytes.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle, or an empty EventHandle if the event is full.
+		template <typename Callable>
+			requires std::is_invocable_v<std::decay_t<Callable>&, const EventArgs&>
+		[[nodiscard]] EventHandle Subscribe(Callable&& handler)
+		{
+			Handler storedHandler(std::forward<Callable>(handler));
+
+			// A reclaimed handler is destroyed once the mutex is unlocked, as destroying it may release handles
+			Handler reclaimedHandler;
+			std::lock_guard<Mutex> lock(m_core.Mutex());
+
+			std::size_t index = FindEntry(false);
+			if (index == Capacity && NoTriggerRunning())
+			{
+				index = FindEntry(true);
+			}
+			if (index == Capacity)
+			{
+				return EventHandle();
+			}
+
+			detail::SubscriptionSlot* slot = m_core.AcquireSlot();
+			if (!slot)
+			{
+				return EventHandle();
+			}
+
+			if (IsOccupied(index))
+			{
+				reclaimedHandler = std::move(HandlerAt(index));
+				Release(index);
+			}
+
+			const std::uint32_t generation = slot->generation.load(std::memory_order_relaxed);
+			::new (static_cast<void*>(m_handlers[index])) Handler(std::move(storedHandler));
+			m_bindings[index] = Binding{slot, generation};
+			m_occupied[index / BitsPerWord] |= MaskOf(index);
+
+			slot->liveWord = &m_live[index / BitsPerWord];
+			slot->liveMask = MaskOf(index);
+			m_live[index / BitsPerWord].fetch_or(MaskOf(index), std::memory_order_release);
+
+			return EventHandle(&m_core, slot, generation);
+		}
+
+		/// @brief Subscribes a member function of an object to the event. Only the object pointer is stored.
+		/// The object must outlive the subscription.
+		/// @tparam Method The member function to invoke, e.g. &MyClass::OnEvent.
+		/// @param instance The object on which the member function is invoked.
+		/// @return An EventHandle that is used to manage the subscription's lifecycle, or an empty EventHandle if the event is full.
+		template <auto Method, typename Class>
+			requires std::is_member_function_pointer_v<decltype(Method)> &&
+					 std::is_invocable_v<decltype(Method), Class&, const EventArgs&>
+		[[nodiscard]] EventHandle Subscribe(Class& instance)
+		{
+			return Subscribe(detail::MemberDelegate<Method, Class>{&instance});
+		}
+
+		/// @brief Unsubscribes a handle from the event using the provided EventHandle. Runs in constant time.
+		/// @param eventHandle The EventHandle representing the subscription to be removed.
+		void Unsubscribe(const EventHandle& eventHandle)
+		{
+			if (eventHandle.m_registry != &m_core)
+			{
+				return;
+			}
+
+			std::lock_guard<Mutex> lock(m_core.Mutex());
+			m_core.Expire(*eventHandle.m_slot, eventHandle.m_generation);
+		}
+
+		/// @brief Triggers the event, invoking all subscribed handlers with the provided EventArgs. Invokes handlers in the same thread that calls this method.
+		/// A handler whose subscription ends while the event is triggered is not invoked anymore.
+		/// @param args The event arguments to be passed to each handler when the event is triggered.
+		void Trigger(const EventArgs& args) const
+		{
+			const TriggerScope scope(m_runningTriggers);
+
+			for (std::size_t word = 0; word < WordCount; ++word)
+			{
+				std::uint64_t bits = m_live[word].load(std::memory_order_acquire);
+				while (bits != 0)
+				{
+					const std::size_t index = word * BitsPerWord + static_cast<std::size_t>(std::countr_zero(bits));
+					bits &= bits - 1;
+					HandlerAt(index)(args);
+
+					// The handler may have ended the subscriptions of the entries left in the word
+					bits &= m_live[word].load(std::memory_order_acquire);
+				}
+			}
+		}
+
+		/// @brief Clears all handlers from the event, effectively unsubscribing all subscribers.
+		/// Their entries are reused by later subscriptions.
+		void Clear()
+		{
+			std::lock_guard<Mutex> lock(m_core.Mutex());
+			for (std::size_t index = 0; index < Capacity; ++index)
+			{
+				if (IsOccupied(index))
+				{
+					m_core.Expire(*m_bindings[index].slot, m_bindings[index].generation);
+				}
+			}
+		}
+
+		/// @brief Destroys the handlers of ended subscriptions, if no Trigger is running.
+		void ClearExpired()
+		{
+			for (std::size_t index = 0; index < Capacity; ++index)
+			{
+				Handler reclaimedHandler;
+				std::lock_guard<Mutex> lock(m_core.Mutex());
+				if (!NoTriggerRunning())
+				{
+					return;
+				}
+				if (IsOccupied(index) && !IsAlive(index))
+				{
+					reclaimedHandler = std::move(HandlerAt(index));
+					Release(index);
+				}
+			}
+		}
+
+		/// @brief Returns the number of handlers of alive subscriptions.
+		std::size_t LiveHandlerCount() const
+		{
+			std::size_t count = 0;
+			for (std::size_t word = 0; word < WordCount; ++word)
+			{
+				count += static_cast<std::size_t>(std::popcount(m_live[word].load(std::memory_order_relaxed)));
+			}
+			return count;
+		}
+
+		/// @brief Returns the number of handlers of ended subscriptions that are still stored, waiting to be reused.
+		std::size_t ExpiredHandlerCount() const { return m_core.ExpiredHandlerCount(); }
+
+	  private:
+		using Mutex = typename ThreadingPolicy::Mutex;
+
+		static constexpr std::size_t BitsPerWord = 64;
+		static constexpr std::size_t WordCount = (Capacity + BitsPerWord - 1) / BitsPerWord;
+
+		/// @brief Subscription a handler belongs to.
+		struct Binding
+		{
+			detail::SubscriptionSlot* slot = nullptr;
+			std::uint32_t generation = 0;
+		};
+
+		/// @brief Slot registry using inline slots only.
+		struct Core final : detail::LockedSubscriptionRegistry<Mutex>
+		{
+			Core() noexcept { this->UseFixedSlots(slots, Capacity); }
+
+			detail::SubscriptionSlot slots[Capacity];
+		};
+
+		/// @brief Counts a Trigger as running for its whole duration, even if a handler throws.
+		class TriggerScope
+		{
+		  public:
+			explicit TriggerScope(std::atomic<std::size_t>& runningTriggers) noexcept : m_runningTriggers(runningTriggers)
+			{
+				m_runningTriggers.fetch_add(1, std::memory_order_seq_cst);
+			}
+			TriggerScope(const TriggerScope&) = delete;
+			TriggerScope& operator=(const TriggerScope&) = delete;
+			~TriggerScope() { m_runningTriggers.fetch_sub(1, std::memory_order_release); }
+
+		  private:
+			std::atomic<std::size_t>& m_runningTriggers;
+		};
+
+		static constexpr std::uint64_t MaskOf(std::size_t index) noexcept
+		{
+			return std::uint64_t{1} << (index % BitsPerWord);
+		}
+
+		Handler& HandlerAt(std::size_t index) const noexcept
+		{
+			return *std::launder(reinterpret_cast<Handler*>(const_cast<std::byte*>(m_handlers[index])));
+		}
+
+		bool IsOccupied(std::size_t index) const noexcept { return (m_occupied[index / BitsPerWord] & MaskOf(index)) != 0; }
+
+		bool IsAlive(std::size_t index) const noexcept
+		{
+			return (m_live[index / BitsPerWord].load(std::memory_order_relaxed) & MaskOf(index)) != 0;
+		}
+
+		/// @brief Returns true if no Trigger is running, so no Trigger can still be invoking a handler whose liveness bit was cleared.
+		/// Must be called with the mutex held.
+		bool NoTriggerRunning() const noexcept
+		{
+			// A read-modify-write orders the liveness bit updates made so far before the read of the counter
+			return m_runningTriggers.fetch_add(0, std::memory_order_seq_cst) == 0;
+		}
+
+		/// @brief Finds a free entry, or an entry whose subscription ended. Must be called with the mutex held.
+		/// @param expired True to look for an entry whose subscription ended, false for a never used or reclaimed one.
+		/// @return The index of the entry, or Capacity if there is none.
+		std::size_t FindEntry(bool expired) const noexcept
+		{
+			for (std::size_t word = 0; word < WordCount; ++word)
+			{
+				std::uint64_t candidates = expired ? m_occupied[word] & ~m_live[word].load(std::memory_order_relaxed)
+												   : ~m_occupied[word];
+				const std::size_t remaining = Capacity - word * BitsPerWord;
+				if (remaining < BitsPerWord)
+				{
+					candidates &= (std::uint64_t{1} << remaining) - 1;
+				}
+				if (candidates != 0)
+				{
+					return word * BitsPerWord + static_cast<std::size_t>(std::countr_zero(candidates));
+				}
+			}
+			return Capacity;
+		}
+
+		/// @brief Destroys the moved-from handler of an ended subscription and frees its entry. Must be called with the mutex held.
+		void Release(std::size_t index) noexcept
+		{
+			HandlerAt(index).~Handler();
+			m_occupied[index / BitsPerWord] &= ~MaskOf(index);
+			m_core.ForgetExpiredHandlers(1);
+		}
+
+	  private:
+		/// @brief Slot registry, referenced by the EventHandles issued by the event.
+		Core m_core;
+
+		/// @brief Inline storage of the handlers.
+		alignas(Handler) std::byte m_handlers[Capacity][sizeof(Handler)];
+
+		/// @brief Subscription of each occupied entry. Guarded by the mutex.
+		Binding m_bindings[Capacity];
+
+		/// @brief Liveness bitset, one bit per entry. Trigger only invokes the handlers whose bit is set.
+		std::atomic<std::uint64_t> m_live[WordCount] = {};
+
+		/// @brief Entries holding a constructed handler, alive or not. Guarded by the mutex.
+		std::uint64_t m_occupied[WordCount] = {};
+
+		/// @brief Number of Trigger calls in progress. Entries of ended subscriptions are only reused when it is zero.
+		mutable std::atomic<std::size_t> m_runningTriggers{0};
+	};
+
+	/// @brief Fixed-capacity event usable from any thread. Writers are serialized on a std::mutex.
+	/// Use BasicStaticEvent directly to choose another threading policy or handler capacity.
+	template <std::size_t Capacity, typename EventArgs>
+	using StaticEvent = BasicStaticEvent<MultiThreaded, DefaultInlineFunctionCapacity, Capacity, EventArgs>;
+} // namespace onion
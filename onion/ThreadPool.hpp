@@ -0,0 +1,478 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace onion
+{
+	namespace detail
+	{
+		/// @brief Intrusively reference counted state of an asynchronous operation, shared by the worker running it and its Completion.
+		class CompletionState
+		{
+		  public:
+			CompletionState() = default;
+			CompletionState(const CompletionState&) = delete;
+			CompletionState& operator=(const CompletionState&) = delete;
+			virtual ~CompletionState() = default;
+
+			void AddRef() noexcept { m_references.fetch_add(1, std::memory_order_relaxed); }
+
+			void ReleaseRef() noexcept
+			{
+				if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					delete this;
+				}
+			}
+
+			bool IsDone() const noexcept { return m_done.load(std::memory_order_acquire); }
+
+			void Wait() const noexcept { m_done.wait(false, std::memory_order_acquire); }
+
+			/// @brief Exception thrown by the operation, if any. Only read once IsDone returns true.
+			const std::exception_ptr& Exception() const noexcept { return m_exception; }
+
+		  protected:
+			/// @brief Marks the operation as done and wakes the waiters. Called once, by the worker that ran the operation.
+			void Complete(std::exception_ptr exception) noexcept
+			{
+				m_exception = std::move(exception);
+				m_done.store(true, std::memory_order_release);
+				m_done.notify_all();
+			}
+
+		  private:
+			std::atomic<std::uint32_t> m_references{1};
+			std::atomic<bool> m_done{false};
+			std::exception_ptr m_exception;
+		};
+
+		/// @brief Range of indices split between the participants of a ParallelFor. Each participant owns a subrange, from which it
+		/// takes chunks at the front; a participant whose subrange is empty steals the back half of another one, or all of it when it
+		/// is no larger than a chunk. A subrange is a single atomic word, so taking and stealing are lock-free.
+		/// Reference counted, as helpers may join after the work is done.
+		class ParallelJob
+		{
+		  public:
+			static constexpr std::size_t MaxParticipants = 64;
+
+			ParallelJob(std::size_t count,
+						std::size_t grain,
+						std::size_t participants,
+						void (*invoke)(void* function, std::size_t begin, std::size_t end),
+						void* function) noexcept
+				: m_count(count), m_grain(grain), m_participants(participants), m_invoke(invoke), m_function(function)
+			{
+				for (std::size_t slot = 0; slot < participants; ++slot)
+				{
+					m_ranges[slot].store(Pack(slot * count / participants, (slot + 1) * count / participants),
+										 std::memory_order_relaxed);
+				}
+			}
+
+			ParallelJob(const ParallelJob&) = delete;
+			ParallelJob& operator=(const ParallelJob&) = delete;
+
+			void AddRef() noexcept { m_references.fetch_add(1, std::memory_order_relaxed); }
+
+			void ReleaseRef() noexcept
+			{
+				if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					delete this;
+				}
+			}
+
+			/// @brief Runs chunks as a helper, if a subrange is left for it. Called by pool workers.
+			static void RunHelper(void* context) noexcept
+			{
+				ParallelJob* job = static_cast<ParallelJob*>(context);
+				const std::size_t slot = job->m_nextSlot.fetch_add(1, std::memory_order_relaxed);
+				if (slot < job->m_participants)
+				{
+					job->Participate(slot);
+				}
+				job->ReleaseRef();
+			}
+
+			/// @brief Runs chunks until no work is left to take or steal.
+			/// @param slot The subrange owned by the participant.
+			void Participate(std::size_t slot) noexcept
+			{
+				std::size_t begin = 0;
+				std::size_t end = 0;
+				for (;;)
+				{
+					if (TakeFront(slot, begin, end))
+					{
+						Run(begin, end);
+					}
+					else if (!Steal(slot))
+					{
+						return;
+					}
+				}
+			}
+
+			/// @brief Blocks until every index has been processed.
+			void Wait() const noexcept
+			{
+				for (std::size_t done = m_completed.load(std::memory_order_acquire); done != m_count;
+					 done = m_completed.load(std::memory_order_acquire))
+				{
+					m_completed.wait(done, std::memory_order_acquire);
+				}
+			}
+
+			/// @brief First exception thrown by a chunk, if any. Only read after Wait.
+			const std::exception_ptr& Exception() const noexcept { return m_exception; }
+
+		  private:
+			static std::uint64_t Pack(std::size_t begin, std::size_t end) noexcept
+			{
+				return (static_cast<std::uint64_t>(begin) << 32) | static_cast<std::uint64_t>(end);
+			}
+
+			static std::size_t BeginOf(std::uint64_t range) noexcept { return static_cast<std::size_t>(range >> 32); }
+			static std::size_t EndOf(std::uint64_t range) noexcept { return static_cast<std::size_t>(range & 0xFFFFFFFFu); }
+
+			/// @brief Takes a chunk at the front of the subrange of a participant.
+			/// @param begin Set to the beginning of the chunk, only if one was taken.
+			/// @param end Set to the end of the chunk, only if one was taken.
+			bool TakeFront(std::size_t slot, std::size_t& begin, std::size_t& end) noexcept
+			{
+				std::uint64_t range = m_ranges[slot].load(std::memory_order_relaxed);
+				for (;;)
+				{
+					if (BeginOf(range) >= EndOf(range))
+					{
+						return false;
+					}
+
+					// A thief may take the chunk before the exchange, so it is only handed out once taken
+					const std::size_t chunkBegin = BeginOf(range);
+					const std::size_t chunkEnd = std::min(chunkBegin + m_grain, EndOf(range));
+					if (m_ranges[slot].compare_exchange_weak(range, Pack(chunkEnd, EndOf(range)), std::memory_order_relaxed))
+					{
+						begin = chunkBegin;
+						end = chunkEnd;
+						return true;
+					}
+				}
+			}
+
+			/// @brief Moves work from the subrange of another participant to the empty subrange of the given one.
+			bool Steal(std::size_t slot) noexcept
+			{
+				for (std::size_t offset = 1; offset < m_participants; ++offset)
+				{
+					std::atomic<std::uint64_t>& victim = m_ranges[(slot + offset) % m_participants];
+					std::uint64_t range = victim.load(std::memory_order_relaxed);
+					while (BeginOf(range) < EndOf(range))
+					{
+						const std::size_t begin = BeginOf(range);
+						const std::size_t end = EndOf(range);
+						const std::size_t middle = end - begin <= m_grain ? begin : begin + (end - begin) / 2;
+						if (victim.compare_exchange_weak(range, Pack(begin, middle), std::memory_order_relaxed))
+						{
+							// Nobody steals from an empty subrange, so the participant is the only one writing its own
+							m_ranges[slot].store(Pack(middle, end), std::memory_order_relaxed);
+							return true;
+						}
+					}
+				}
+				return false;
+			}
+
+			void Run(std::size_t begin, std::size_t end) noexcept
+			{
+				try
+				{
+					m_invoke(m_function, begin, end);
+				}
+				catch (...)
+				{
+					if (!m_failed.exchange(true, std::memory_order_relaxed))
+					{
+						m_exception = std::current_exception();
+					}
+				}
+
+				if (m_completed.fetch_add(end - begin, std::memory_order_acq_rel) + (end - begin) == m_count)
+				{
+					m_completed.notify_all();
+				}
+			}
+
+		  private:
+			const std::size_t m_count;
+			const std::size_t m_grain;
+			const std::size_t m_participants;
+			void (*const m_invoke)(void*, std::size_t, std::size_t);
+			void* const m_function;
+
+			/// @brief Subrange owned by each participant, begin in the high half and end in the low half.
+			std::atomic<std::uint64_t> m_ranges[MaxParticipants];
+
+			/// @brief Next subrange to give to a helper. The caller owns the first one.
+			std::atomic<std::size_t> m_nextSlot{1};
+
+			/// @brief Number of processed indices.
+			std::atomic<std::size_t> m_completed{0};
+
+			std::atomic<bool> m_failed{false};
+			std::exception_ptr m_exception;
+			std::atomic<std::uint32_t> m_references{1};
+		};
+	} // namespace detail
+
+	/// @brief Handle to an operation running asynchronously, such as an asynchronous trigger. It can be ignored: the operation runs to
+	/// completion whether or not the handle is kept.
+	class Completion
+	{
+	  public:
+		Completion() = default;
+
+		/// @brief Adopts a reference to the state of an operation.
+		explicit Completion(detail::CompletionState* state) noexcept : m_state(state) {}
+
+		Completion(const Completion& other) noexcept : m_state(other.m_state)
+		{
+			if (m_state)
+			{
+				m_state->AddRef();
+			}
+		}
+
+		Completion(Completion&& other) noexcept : m_state(std::exchange(other.m_state, nullptr)) {}
+
+		Completion& operator=(Completion other) noexcept
+		{
+			std::swap(m_state, other.m_state);
+			return *this;
+		}
+
+		~Completion()
+		{
+			if (m_state)
+			{
+				m_state->ReleaseRef();
+			}
+		}
+
+		/// @brief Returns true if the handle refers to an operation, false if it is default constructed, moved from,
+		/// or the operation was rejected because the queue was full.
+		explicit operator bool() const noexcept { return m_state != nullptr; }
+
+		/// @brief Returns true once the operation finished. An empty handle is always done.
+		bool IsDone() const noexcept { return !m_state || m_state->IsDone(); }
+
+		/// @brief Blocks until the operation finished, then rethrows the exception it threw, if any.
+		void Wait() const
+		{
+			if (m_state)
+			{
+				m_state->Wait();
+				if (m_state->Exception())
+				{
+					std::rethrow_exception(m_state->Exception());
+				}
+			}
+		}
+
+	  private:
+		detail::CompletionState* m_state = nullptr;
+	};
+
+	/// @brief Fixed set of worker threads running tasks from a bounded queue. Posting never blocks: a task is rejected when the queue
+	/// is full. The destructor runs the queued tasks, then joins the workers.
+	class ThreadPool
+	{
+	  public:
+		/// @brief Task run by a worker: a function called once with its context. It must not throw.
+		struct Task
+		{
+			void (*run)(void* context) noexcept;
+			void* context;
+		};
+
+	  public:
+		/// @brief Starts the workers.
+		/// @param workerCount The number of worker threads. Zero uses one per hardware thread.
+		/// @param queueCapacity The maximum number of queued tasks.
+		explicit ThreadPool(std::size_t workerCount = 0, std::size_t queueCapacity = 1024)
+			: m_tasks(queueCapacity > 0 ? queueCapacity : 1)
+		{
+			if (workerCount == 0)
+			{
+				workerCount = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+			}
+
+			m_workers.reserve(workerCount);
+			try
+			{
+				for (std::size_t i = 0; i < workerCount; ++i)
+				{
+					m_workers.emplace_back([this] { Work(); });
+				}
+			}
+			catch (...)
+			{
+				Stop();
+				throw;
+			}
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		~ThreadPool() { Stop(); }
+
+		/// @brief Pool owned by the library, with one worker per hardware thread, created on first use.
+		static ThreadPool& Shared()
+		{
+			static ThreadPool pool;
+			return pool;
+		}
+
+		/// @brief Queues a task without blocking.
+		/// @return True if the task was queued, false if the queue is full.
+		bool TryPost(Task task)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_count == m_tasks.size())
+				{
+					return false;
+				}
+				m_tasks[(m_head + m_count) % m_tasks.size()] = task;
+				++m_count;
+				if (m_idleWorkers == 0)
+				{
+					return true;
+				}
+			}
+			m_wakeUp.notify_one();
+			return true;
+		}
+
+		/// @brief Returns the number of worker threads.
+		std::size_t WorkerCount() const noexcept { return m_workers.size(); }
+
+		/// @brief Calls a function on chunks of the indices [0, count) in parallel, then returns once every chunk has been processed.
+		/// The calling thread processes chunks too, while workers that are free help it, stealing half of the remaining work from one
+		/// another to balance the load. Runs inline when the range holds a single chunk or no worker can help.
+		/// @param count The number of indices.
+		/// @param grain The minimum number of indices per chunk.
+		/// @param function The function, called as function(begin, end) for each chunk, possibly from several threads at once.
+		/// If it throws, the other chunks still run and the first exception is rethrown.
+		template <typename Function> void ParallelFor(std::size_t count, std::size_t grain, Function&& function)
+		{
+			grain = grain > 0 ? grain : 1;
+			const std::size_t chunks = (count + grain - 1) / grain;
+			const std::size_t participants = std::min({WorkerCount() + 1, chunks, detail::ParallelJob::MaxParticipants});
+			if (participants <= 1 || count > std::numeric_limits<std::uint32_t>::max())
+			{
+				if (count > 0)
+				{
+					function(std::size_t{0}, count);
+				}
+				return;
+			}
+
+			using Stored = std::remove_reference_t<Function>;
+			detail::ParallelJob* job = new detail::ParallelJob(
+				count, grain, participants,
+				[](void* stored, std::size_t begin, std::size_t end) { (*static_cast<Stored*>(stored))(begin, end); },
+				const_cast<void*>(static_cast<const void*>(std::addressof(function))));
+
+			for (std::size_t helper = 1; helper < participants; ++helper)
+			{
+				job->AddRef();
+				if (!TryPost(Task{&detail::ParallelJob::RunHelper, job}))
+				{
+					job->ReleaseRef();
+					break;
+				}
+			}
+
+			job->Participate(0);
+			job->Wait();
+			const std::exception_ptr exception = job->Exception();
+			job->ReleaseRef();
+			if (exception)
+			{
+				std::rethrow_exception(exception);
+			}
+		}
+
+	  private:
+		void Work()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			for (;;)
+			{
+				while (m_count == 0 && !m_stopping)
+				{
+					++m_idleWorkers;
+					m_wakeUp.wait(lock);
+					--m_idleWorkers;
+				}
+				if (m_count == 0)
+				{
+					return;
+				}
+
+				const Task task = m_tasks[m_head];
+				m_head = (m_head + 1) % m_tasks.size();
+				--m_count;
+
+				lock.unlock();
+				task.run(task.context);
+				lock.lock();
+			}
+		}
+
+		void Stop() noexcept
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stopping = true;
+			}
+			m_wakeUp.notify_all();
+			for (std::thread& worker : m_workers)
+			{
+				worker.join();
+			}
+		}
+
+	  private:
+		std::mutex m_mutex;
+		std::condition_variable m_wakeUp;
+
+		/// @brief Ring buffer of queued tasks. Guarded by the mutex.
+		std::vector<Task> m_tasks;
+		std::size_t m_head = 0;
+		std::size_t m_count = 0;
+
+		/// @brief Workers waiting for a task. Posting only notifies when there is one. Guarded by the mutex.
+		std::size_t m_idleWorkers = 0;
+
+		/// @brief Set by the destructor: workers exit once the queue is empty. Guarded by the mutex.
+		bool m_stopping = false;
+
+		std::vector<std::thread> m_workers;
+	};
+} // namespace onion
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace onion
+{
+	/// @brief Mutex that does nothing, for events only used from a single thread.
+	class NullMutex
+	{
+	  public:
+		void lock() noexcept {}
+		bool try_lock() noexcept { return true; }
+		void unlock() noexcept {}
+	};
+
+	/// @brief Test-and-test-and-set spin lock, for critical sections short enough that parking the thread would cost more than spinning.
+	class SpinMutex
+	{
+	  public:
+		void lock() noexcept
+		{
+			for (unsigned spins = 0; m_locked.exchange(true, std::memory_order_acquire); ++spins)
+			{
+				while (m_locked.load(std::memory_order_relaxed))
+				{
+					if (++spins >= YieldAfterSpins)
+					{
+						std::this_thread::yield();
+						spins = 0;
+					}
+				}
+			}
+		}
+
+		bool try_lock() noexcept
+		{
+			return !m_locked.load(std::memory_order_relaxed) && !m_locked.exchange(true, std::memory_order_acquire);
+		}
+
+		void unlock() noexcept { m_locked.store(false, std::memory_order_release); }
+
+	  private:
+		static constexpr unsigned YieldAfterSpins = 64;
+
+		std::atomic<bool> m_locked{false};
+	};
+
+	/// @brief Threading policy of an event used from several threads, serializing writers on a std::mutex. This is the default.
+	struct MultiThreaded
+	{
+		using Mutex = std::mutex;
+		static constexpr bool IsConcurrent = true;
+	};
+
+	/// @brief Threading policy of an event used from several threads, serializing writers on a spin lock.
+	struct SpinLocked
+	{
+		using Mutex = SpinMutex;
+		static constexpr bool IsConcurrent = true;
+	};
+
+	/// @brief Threading policy of an event used from a single thread: locks compile away and the handlers list is published without atomics.
+	struct SingleThreaded
+	{
+		using Mutex = NullMutex;
+		static constexpr bool IsConcurrent = false;
+	};
+} // namespace onion
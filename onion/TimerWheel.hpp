@@ -0,0 +1,285 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace onion
+{
+	namespace detail
+	{
+		/// @brief Timer scheduled on a TimerWheel, embedded in its owner. The owner keeps it alive until it expires, so the wheel never
+		/// cancels timers and never allocates.
+		struct TimerNode
+		{
+			/// @brief Next timer of the same wheel slot. Owned by the wheel while scheduled.
+			TimerNode* next = nullptr;
+
+			/// @brief Tick at which the timer expires.
+			std::uint64_t deadline = 0;
+
+			/// @brief Called once the timer is taken out of the wheel, outside of the wheel mutex: with fired set when its deadline
+			/// is reached, with fired cleared when the wheel is destroyed first. May schedule the timer again.
+			void (*expire)(TimerNode& node, bool fired) noexcept = nullptr;
+		};
+	} // namespace detail
+
+	/// @brief Hierarchical timer wheel: four levels of 64 slots, each level counting in units of 64 slots of the level below.
+	/// Scheduling and expiring a timer are constant time whatever the number of timers, and a single thread advancing the wheel
+	/// drives all of them. Timers further than 64^4 ticks away are parked in the last level until they come in range.
+	class TimerWheel
+	{
+	  public:
+		using Clock = std::chrono::steady_clock;
+
+		/// @brief Who advances the wheel.
+		enum class Driver
+		{
+			/// @brief The owner calls Advance, e.g. once per iteration of its loop.
+			Manual,
+
+			/// @brief A thread owned by the wheel advances it once per tick.
+			OwnThread
+		};
+
+	  public:
+		/// @brief Creates a wheel whose tick 0 is now.
+		/// @param resolution The duration of a tick. Timers expire on the first tick at or after their deadline.
+		/// @param driver Who advances the wheel.
+		explicit TimerWheel(Clock::duration resolution = std::chrono::milliseconds(1), Driver driver = Driver::Manual)
+			: m_resolution(std::max(resolution, Clock::duration(1))), m_epoch(Clock::now()), m_driver(driver)
+		{
+			if (driver == Driver::OwnThread)
+			{
+				m_thread = std::thread([this] { Run(); });
+			}
+		}
+
+		TimerWheel(const TimerWheel&) = delete;
+		TimerWheel& operator=(const TimerWheel&) = delete;
+
+		/// @brief Stops the thread of the wheel, if any, then hands every scheduled timer back to its owner without firing it.
+		~TimerWheel()
+		{
+			if (m_thread.joinable())
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_threadMutex);
+					m_stopping = true;
+				}
+				m_stopped.notify_one();
+				m_thread.join();
+			}
+
+			detail::TimerNode* timers = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				for (detail::TimerNode*(&level)[SlotCount] : m_slots)
+				{
+					for (detail::TimerNode*& slot : level)
+					{
+						while (detail::TimerNode* node = slot)
+						{
+							slot = node->next;
+							node->next = timers;
+							timers = node;
+						}
+					}
+				}
+			}
+			Expire(timers, false);
+		}
+
+		/// @brief Returns the wheel shared by the events that are not given one, with a resolution of one millisecond, advanced
+		/// by its own thread.
+		static TimerWheel& Shared()
+		{
+			static TimerWheel wheel(std::chrono::milliseconds(1), Driver::OwnThread);
+			return wheel;
+		}
+
+		/// @brief Returns true if the owner advances the wheel, so its timers expire on the threads calling Advance.
+		bool IsManual() const noexcept { return m_driver == Driver::Manual; }
+
+		/// @brief Returns the current tick.
+		std::uint64_t Now() const noexcept { return m_now.load(std::memory_order_acquire); }
+
+		/// @brief Returns the number of ticks covering a duration, rounded up, and at least one.
+		std::uint64_t TicksFor(Clock::duration delay) const noexcept
+		{
+			const Clock::duration rounded = std::max(delay, Clock::duration(0)) + m_resolution - Clock::duration(1);
+			return std::max<std::uint64_t>(static_cast<std::uint64_t>(rounded / m_resolution), 1);
+		}
+
+		/// @brief Schedules a timer that is not scheduled yet. A deadline that has passed expires on the next tick.
+		/// @param node The timer. Its owner must keep it alive until it expires.
+		/// @param deadline The tick at which the timer expires.
+		void Schedule(detail::TimerNode& node, std::uint64_t deadline) noexcept
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			node.deadline = std::max(deadline, m_tick + 1);
+			Insert(node);
+		}
+
+		/// @brief Advances the wheel to the current time, expiring the timers whose deadline is reached.
+		/// @return The number of expired timers.
+		std::size_t Advance() noexcept { return AdvanceTo(Clock::now()); }
+
+		/// @brief Advances the wheel to the given time, expiring the timers whose deadline is reached, in deadline order.
+		/// Timers are expired on the calling thread, once the wheel mutex is unlocked.
+		/// @return The number of expired timers.
+		std::size_t AdvanceTo(Clock::time_point time) noexcept
+		{
+			const std::uint64_t target = time > m_epoch ? static_cast<std::uint64_t>((time - m_epoch) / m_resolution) : 0;
+
+			// Expired timers are gathered in a list kept in expiration order
+			detail::TimerNode* expired = nullptr;
+			detail::TimerNode** last = &expired;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				while (m_tick < target)
+				{
+					++m_tick;
+					Cascade();
+
+					detail::TimerNode* node = std::exchange(m_slots[0][m_tick & SlotMask], nullptr);
+					while (node)
+					{
+						detail::TimerNode* next = node->next;
+						if (node->deadline <= m_tick)
+						{
+							node->next = nullptr;
+							*last = node;
+							last = &node->next;
+						}
+						else
+						{
+							Insert(*node);
+						}
+						node = next;
+					}
+				}
+				m_now.store(m_tick, std::memory_order_release);
+			}
+			return Expire(expired, true);
+		}
+
+	  private:
+		static constexpr unsigned SlotBits = 6;
+		static constexpr std::size_t SlotCount = std::size_t{1} << SlotBits;
+		static constexpr std::uint64_t SlotMask = SlotCount - 1;
+		static constexpr unsigned LevelCount = 4;
+
+		/// @brief Number of ticks covered by the whole wheel.
+		static constexpr std::uint64_t Range = std::uint64_t{1} << (SlotBits * LevelCount);
+
+		/// @brief Links a timer into the slot of its deadline, at the lowest level whose range covers it. Must be called with the
+		/// mutex held.
+		void Insert(detail::TimerNode& node) noexcept
+		{
+			const std::uint64_t delta = node.deadline > m_tick ? node.deadline - m_tick : 0;
+			unsigned level = 0;
+			while (level + 1 < LevelCount && delta >= (std::uint64_t{1} << (SlotBits * (level + 1))))
+			{
+				++level;
+			}
+
+			// Timers out of range are parked in the last slot reached before the current one comes back
+			const std::uint64_t slot = delta < Range ? (node.deadline >> (SlotBits * level)) & SlotMask
+													 : ((m_tick >> (SlotBits * level)) + SlotMask) & SlotMask;
+			node.next = m_slots[level][slot];
+			m_slots[level][slot] = &node;
+		}
+
+		/// @brief Moves the timers of the upper slots reached by the current tick to the levels below, highest level first, so they
+		/// land in slots that are still ahead. Must be called with the mutex held.
+		void Cascade() noexcept
+		{
+			for (unsigned level = LevelCount - 1; level > 0; --level)
+			{
+				const std::uint64_t unit = std::uint64_t{1} << (SlotBits * level);
+				if (m_tick & (unit - 1))
+				{
+					continue;
+				}
+
+				detail::TimerNode* node = std::exchange(m_slots[level][(m_tick >> (SlotBits * level)) & SlotMask], nullptr);
+				while (node)
+				{
+					detail::TimerNode* next = node->next;
+					Insert(*node);
+					node = next;
+				}
+			}
+		}
+
+		/// @brief Hands a list of timers back to their owners.
+		/// @return The number of timers.
+		static std::size_t Expire(detail::TimerNode* node, bool fired) noexcept
+		{
+			std::size_t count = 0;
+			while (node)
+			{
+				// The owner may schedule the timer again, which overwrites its link
+				detail::TimerNode* next = node->next;
+				node->next = nullptr;
+				node->expire(*node, fired);
+				node = next;
+				++count;
+			}
+			return count;
+		}
+
+		/// @brief Body of the thread of the wheel: advances the wheel once per tick until the wheel is destroyed.
+		void Run()
+		{
+			std::unique_lock<std::mutex> lock(m_threadMutex);
+			while (!m_stopped.wait_for(lock, m_resolution, [this] { return m_stopping; }))
+			{
+				lock.unlock();
+				Advance();
+				lock.lock();
+			}
+		}
+
+	  private:
+		/// @brief Duration of a tick.
+		const Clock::duration m_resolution;
+
+		/// @brief Time of tick 0.
+		const Clock::time_point m_epoch;
+
+		/// @brief Who advances the wheel.
+		const Driver m_driver;
+
+		/// @brief Guards the slots and the current tick.
+		std::mutex m_mutex;
+
+		/// @brief Current tick. Guarded by the mutex.
+		std::uint64_t m_tick = 0;
+
+		/// @brief Current tick, readable without the mutex.
+		std::atomic<std::uint64_t> m_now{0};
+
+		/// @brief Scheduled timers, as singly linked lists per level and slot. Guarded by the mutex.
+		detail::TimerNode* m_slots[LevelCount][SlotCount] = {};
+
+		/// @brief Guards m_stopping.
+		std::mutex m_threadMutex;
+
+		/// @brief Wakes the thread of the wheel when it must stop.
+		std::condition_variable m_stopped;
+
+		/// @brief Set by the destructor. Guarded by m_threadMutex.
+		bool m_stopping = false;
+
+		/// @brief Thread advancing the wheel, if it drives itself.
+		std::thread m_thread;
+	};
+} // namespace onion
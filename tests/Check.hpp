@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+/// @brief Fails the test when a condition does not hold. Unlike assert, it is kept in release builds.
+#define ONION_CHECK(condition)                                                                                                   \
+	do                                                                                                                           \
+	{                                                                                                                            \
+		if (!(condition))                                                                                                        \
+		{                                                                                                                        \
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);                                   \
+			std::abort();                                                                                                        \
+		}                                                                                                                        \
+	} while (false)
+
+/// @brief Runs a test function, printing its name.
+#define ONION_RUN(test)                                                                                                          \
+	do                                                                                                                           \
+	{                                                                                                                            \
+		std::printf("%s\n", #test);                                                                                              \
+		test();                                                                                                                  \
+	} while (false)
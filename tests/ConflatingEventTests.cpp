@@ -0,0 +1,135 @@
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <onion/ConflatingEvent.hpp>
+
+#include "Check.hpp"
+
+namespace
+{
+	/// @brief Conflating event keyed by an int, delivering the key and the latest value posted for it.
+	template <typename ThreadingPolicy>
+	using Quotes = onion::BasicConflatingEvent<ThreadingPolicy, onion::DefaultInlineFunctionCapacity, int, int, int>;
+
+	using Delivery = std::pair<int, int>;
+
+	/// @brief Posts a value for a key, the key being delivered along with the value.
+	template <typename ConflatingEvent> void PostQuote(ConflatingEvent& quotes, int key, int value)
+	{
+		quotes.Post(key, key, value);
+	}
+
+	template <typename ThreadingPolicy> void RepostOverwritesTheArgumentsAndKeepsThePosition()
+	{
+		Quotes<ThreadingPolicy> quotes;
+		std::vector<Delivery> delivered;
+		onion::EventHandle handle = quotes.Subscribe([&delivered](int key, int value) { delivered.emplace_back(key, value); });
+
+		PostQuote(quotes, 1, 10);
+		PostQuote(quotes, 2, 20);
+		PostQuote(quotes, 1, 11);
+		PostQuote(quotes, 3, 30);
+		PostQuote(quotes, 1, 12);
+		ONION_CHECK(quotes.PendingCount() == 3);
+
+		ONION_CHECK(quotes.Pump() == 3);
+		ONION_CHECK((delivered == std::vector<Delivery>{{1, 12}, {2, 20}, {3, 30}}));
+		ONION_CHECK(quotes.PendingCount() == 0);
+
+		// Once pumped, a key is queued again behind the pending ones
+		delivered.clear();
+		PostQuote(quotes, 2, 21);
+		PostQuote(quotes, 1, 13);
+		PostQuote(quotes, 2, 22);
+		ONION_CHECK(quotes.Pump(1) == 1);
+		ONION_CHECK(quotes.Pump() == 1);
+		ONION_CHECK((delivered == std::vector<Delivery>{{2, 22}, {1, 13}}));
+	}
+
+	template <typename ThreadingPolicy> void KeyRepostedDuringPumpIsDeliveredAfterThePendingKeys()
+	{
+		Quotes<ThreadingPolicy> quotes;
+		std::vector<Delivery> delivered;
+		onion::EventHandle handle = quotes.Subscribe(
+			[&quotes, &delivered](int key, int value)
+			{
+				delivered.emplace_back(key, value);
+				if (key == 1 && value == 10)
+				{
+					PostQuote(quotes, 1, 11);
+				}
+			});
+
+		PostQuote(quotes, 1, 10);
+		PostQuote(quotes, 2, 20);
+		PostQuote(quotes, 3, 30);
+		ONION_CHECK(quotes.Pump() == 4);
+		ONION_CHECK((delivered == std::vector<Delivery>{{1, 10}, {2, 20}, {3, 30}, {1, 11}}));
+		ONION_CHECK(quotes.PendingCount() == 0);
+	}
+
+	void PendingCountNeverExceedsTheDistinctKeys()
+	{
+		constexpr int ThreadCount = 4;
+		constexpr int KeysPerThread = 10;
+		constexpr int PostsPerThread = 20000;
+		constexpr std::size_t KeyCount = ThreadCount * KeysPerThread;
+
+		Quotes<onion::MultiThreaded> quotes;
+		std::vector<int> latest(KeyCount, -1);
+		onion::EventHandle handle = quotes.Subscribe(
+			[&latest](int key, int value)
+			{
+				// Values of a key only grow, and conflation may skip some but never reorders them
+				ONION_CHECK(value > latest[key]);
+				latest[key] = value;
+			});
+
+		// Each thread owns its keys, so the last value posted for each key is known. More keys than the smallest key table holds.
+		std::atomic<int> running{ThreadCount};
+		std::vector<std::thread> posters;
+		for (int thread = 0; thread < ThreadCount; ++thread)
+		{
+			posters.emplace_back(
+				[&quotes, &running, thread]
+				{
+					for (int value = 0; value < PostsPerThread; ++value)
+					{
+						PostQuote(quotes, thread * KeysPerThread + value % KeysPerThread, value);
+					}
+					running.fetch_sub(1, std::memory_order_release);
+				});
+		}
+
+		while (running.load(std::memory_order_acquire) > 0)
+		{
+			ONION_CHECK(quotes.PendingCount() <= KeyCount);
+			quotes.Pump(7);
+		}
+		for (std::thread& poster : posters)
+		{
+			poster.join();
+		}
+
+		ONION_CHECK(quotes.PendingCount() <= KeyCount);
+		quotes.Pump();
+		ONION_CHECK(quotes.PendingCount() == 0);
+		for (std::size_t key = 0; key < KeyCount; ++key)
+		{
+			ONION_CHECK(latest[key] == PostsPerThread - KeysPerThread + static_cast<int>(key) % KeysPerThread);
+		}
+	}
+} // namespace
+
+int main()
+{
+	ONION_RUN(RepostOverwritesTheArgumentsAndKeepsThePosition<onion::MultiThreaded>);
+	ONION_RUN(RepostOverwritesTheArgumentsAndKeepsThePosition<onion::SingleThreaded>);
+	ONION_RUN(KeyRepostedDuringPumpIsDeliveredAfterThePendingKeys<onion::MultiThreaded>);
+	ONION_RUN(KeyRepostedDuringPumpIsDeliveredAfterThePendingKeys<onion::SingleThreaded>);
+	ONION_RUN(PendingCountNeverExceedsTheDistinctKeys);
+	return 0;
+}
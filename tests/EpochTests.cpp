@@ -0,0 +1,180 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <onion/ConflatingEvent.hpp>
+#include <onion/Event.hpp>
+#include <onion/KeyedEvent.hpp>
+
+#include "Check.hpp"
+
+namespace
+{
+	/// @brief Handler counting its live copies, which checks it is never invoked once destroyed.
+	struct TrackedHandler
+	{
+		static constexpr std::uint32_t AliveMark = 0xA11CE;
+
+		std::atomic<int>* alive;
+		std::atomic<std::size_t>* calls;
+		std::uint32_t mark = AliveMark;
+
+		TrackedHandler(std::atomic<int>* aliveCount, std::atomic<std::size_t>* callCount) noexcept : alive(aliveCount), calls(callCount)
+		{
+			alive->fetch_add(1, std::memory_order_relaxed);
+		}
+		TrackedHandler(const TrackedHandler& other) noexcept : alive(other.alive), calls(other.calls)
+		{
+			alive->fetch_add(1, std::memory_order_relaxed);
+		}
+		TrackedHandler(TrackedHandler&& other) noexcept : TrackedHandler(static_cast<const TrackedHandler&>(other)) {}
+		TrackedHandler& operator=(const TrackedHandler&) = delete;
+
+		~TrackedHandler()
+		{
+			mark = 0;
+			alive->fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		void operator()(int) const noexcept
+		{
+			ONION_CHECK(mark == AliveMark);
+			calls->fetch_add(1, std::memory_order_relaxed);
+		}
+	};
+
+	void ReplacedListIsDestroyedRightAwayWithoutReaders()
+	{
+		onion::Event<int> event;
+		std::atomic<int> alive{0};
+		std::atomic<std::size_t> calls{0};
+
+		onion::EventHandle handle = event.Subscribe(TrackedHandler(&alive, &calls));
+		ONION_CHECK(alive.load() == 1);
+
+		// No thread is pinned, so the replaced list is destroyed before Clear returns
+		event.Clear();
+		ONION_CHECK(alive.load() == 0);
+	}
+
+	void ListReplacedDuringATriggerOutlivesIt()
+	{
+		onion::Event<int> event;
+		std::atomic<int> alive{0};
+		std::atomic<std::size_t> calls{0};
+		bool keptAlive = false;
+
+		onion::EventHandle tracked = event.Subscribe(TrackedHandler(&alive, &calls), 1);
+		onion::EventHandle clearing = event.Subscribe(
+			[&](int)
+			{
+				event.Clear();
+				keptAlive = alive.load() == 1;
+			});
+
+		event.Trigger(1);
+		ONION_CHECK(keptAlive);
+		ONION_CHECK(calls.load() == 1);
+
+		// Destroyed once the Trigger that was using the list unpinned
+		ONION_CHECK(alive.load() == 0);
+	}
+
+	void ConcurrentTriggersNeverUseADestroyedList()
+	{
+		onion::Event<int> event;
+		std::atomic<int> alive{0};
+		std::atomic<std::size_t> calls{0};
+		std::atomic<bool> stop{false};
+
+		std::vector<std::thread> triggers;
+		for (int thread = 0; thread < 4; ++thread)
+		{
+			triggers.emplace_back(
+				[&]
+				{
+					while (!stop.load(std::memory_order_relaxed))
+					{
+						event.Trigger(1);
+					}
+				});
+		}
+
+		for (int round = 0; round < 2000; ++round)
+		{
+			// Increasing priorities rebuild the list on every subscription
+			std::vector<onion::EventHandle> handles;
+			for (int index = 0; index < 4; ++index)
+			{
+				handles.push_back(event.Subscribe(TrackedHandler(&alive, &calls), index));
+			}
+			if (round % 2 == 0)
+			{
+				event.Clear();
+			}
+		}
+		stop.store(true);
+		for (std::thread& trigger : triggers)
+		{
+			trigger.join();
+		}
+
+		// Every replaced list is destroyed once the readers unpinned and a writer collects
+		event.Clear();
+		ONION_CHECK(alive.load() == 0);
+	}
+
+	void KeyLookupsSurviveConcurrentRehashes()
+	{
+		onion::KeyedEvent<int, int> keyed;
+		onion::ConflatingEvent<int, int> conflating;
+		std::atomic<int> alive{0};
+		std::atomic<std::size_t> calls{0};
+		std::atomic<bool> stop{false};
+
+		onion::EventHandle first = keyed.Subscribe(0, TrackedHandler(&alive, &calls));
+		conflating.Post(0, 0);
+
+		std::vector<std::thread> readers;
+		for (int thread = 0; thread < 3; ++thread)
+		{
+			readers.emplace_back(
+				[&]
+				{
+					while (!stop.load(std::memory_order_relaxed))
+					{
+						keyed.Trigger(0, 1);
+						conflating.Post(0, 1);
+					}
+				});
+		}
+
+		// Each new key eventually grows and replaces the tables the readers are probing
+		std::vector<onion::EventHandle> handles;
+		for (int key = 1; key < 2000; ++key)
+		{
+			handles.push_back(keyed.Subscribe(key, [](int) {}));
+			conflating.Post(key, key);
+		}
+		stop.store(true);
+		for (std::thread& reader : readers)
+		{
+			reader.join();
+		}
+
+		ONION_CHECK(keyed.KeyCount() == 2000);
+		ONION_CHECK(conflating.PendingCount() == 2000);
+		ONION_CHECK(calls.load() > 0);
+	}
+} // namespace
+
+int main()
+{
+	ONION_RUN(ReplacedListIsDestroyedRightAwayWithoutReaders);
+	ONION_RUN(ListReplacedDuringATriggerOutlivesIt);
+	ONION_RUN(ConcurrentTriggersNeverUseADestroyedList);
+	ONION_RUN(KeyLookupsSurviveConcurrentRehashes);
+	return 0;
+}
@@ -0,0 +1,135 @@
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <onion/EventBus.hpp>
+
+#include "Check.hpp"
+
+namespace
+{
+	struct Price
+	{
+		int instrument;
+		double value;
+	};
+
+	/// @brief Distinct event types, each taking a new type index the first time it is used.
+	template <int N> struct Tagged
+	{
+		int value;
+	};
+
+	/// @brief Type nobody subscribes to.
+	struct Unused
+	{
+	};
+
+	void EachTypeHasItsOwnHandlers()
+	{
+		onion::EventBus bus;
+		std::vector<int> ints;
+		std::vector<std::string> strings;
+		std::vector<double> prices;
+
+		onion::EventHandle intHandle = bus.Subscribe<int>([&ints](int value) { ints.push_back(value); });
+		onion::EventHandle stringHandle = bus.Subscribe<std::string>([&strings](const std::string& value) { strings.push_back(value); });
+		onion::EventHandle priceHandle = bus.Subscribe<Price>([&prices](const Price& price) { prices.push_back(price.value); });
+
+		bus.Trigger(1);
+		bus.Trigger(std::string("one"));
+		bus.Trigger(Price{7, 1.5});
+		ONION_CHECK((ints == std::vector<int>{1}));
+		ONION_CHECK((strings == std::vector<std::string>{"one"}));
+		ONION_CHECK((prices == std::vector<double>{1.5}));
+		ONION_CHECK(bus.LiveHandlerCount<int>() == 1);
+
+		// Unsubscribing from another type leaves the handle untouched
+		bus.Unsubscribe<std::string>(intHandle);
+		bus.Trigger(2);
+		ONION_CHECK((ints == std::vector<int>{1, 2}));
+
+		bus.Unsubscribe<int>(intHandle);
+		bus.Trigger(3);
+		bus.Trigger(std::string("two"));
+		ONION_CHECK((ints == std::vector<int>{1, 2}));
+		ONION_CHECK((strings == std::vector<std::string>{"one", "two"}));
+		ONION_CHECK(bus.LiveHandlerCount<int>() == 0);
+		ONION_CHECK(bus.LiveHandlerCount<std::string>() == 1);
+
+		bus.Clear();
+		bus.Trigger(Price{7, 2.5});
+		ONION_CHECK((prices == std::vector<double>{1.5}));
+	}
+
+	void TypeWithoutSubscribersIsIgnored()
+	{
+		onion::EventBus bus;
+		ONION_CHECK(bus.LiveHandlerCount<Unused>() == 0);
+		bus.Trigger(Unused{});
+
+		onion::EventHandle handle = bus.Subscribe<int>([](int) {});
+		bus.Unsubscribe<Unused>(handle);
+		ONION_CHECK(bus.LiveHandlerCount<Unused>() == 0);
+		ONION_CHECK(bus.LiveHandlerCount<int>() == 1);
+	}
+
+	template <int... N> void SubscribeToEach(onion::EventBus& bus, std::vector<onion::EventHandle>& handles, std::atomic<int>& calls,
+											 std::integer_sequence<int, N...>)
+	{
+		(handles.push_back(bus.Subscribe<Tagged<N>>([&calls](const Tagged<N>&) { calls.fetch_add(1, std::memory_order_relaxed); })),
+		 ...);
+	}
+
+	void TableGrowsWhileOtherThreadsTrigger()
+	{
+		onion::EventBus bus;
+		std::atomic<int> triggered{0};
+		std::atomic<int> tagged{0};
+		onion::EventHandle handle =
+			bus.Subscribe<Tagged<0>>([&triggered](const Tagged<0>&) { triggered.fetch_add(1, std::memory_order_relaxed); });
+
+		std::atomic<bool> stop{false};
+		std::vector<std::thread> triggers;
+		for (int thread = 0; thread < 3; ++thread)
+		{
+			triggers.emplace_back(
+				[&]
+				{
+					while (!stop.load(std::memory_order_relaxed))
+					{
+						bus.Trigger(Tagged<0>{0});
+					}
+				});
+		}
+
+		// More types than the smallest table holds, so it is replaced while the triggers read it
+		std::vector<onion::EventHandle> handles;
+		SubscribeToEach(bus, handles, tagged, std::make_integer_sequence<int, 48>());
+		stop.store(true);
+		for (std::thread& trigger : triggers)
+		{
+			trigger.join();
+		}
+
+		const int before = triggered.load();
+		tagged.store(0);
+		bus.Trigger(Tagged<0>{0});
+		bus.Trigger(Tagged<47>{0});
+		ONION_CHECK(triggered.load() == before + 1);
+		ONION_CHECK(tagged.load() == 2);
+		ONION_CHECK(bus.LiveHandlerCount<Tagged<0>>() == 2);
+		ONION_CHECK(bus.LiveHandlerCount<Tagged<47>>() == 1);
+	}
+} // namespace
+
+int main()
+{
+	ONION_RUN(EachTypeHasItsOwnHandlers);
+	ONION_RUN(TypeWithoutSubscribersIsIgnored);
+	ONION_RUN(TableGrowsWhileOtherThreadsTrigger);
+	return 0;
+}
@@ -0,0 +1,530 @@
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <onion/Event.hpp>
+
+#include "Check.hpp"
+
+namespace
+{
+	template <typename EventType> void UnsubscribeAfterRebuildSkipsTheHandler()
+	{
+		// A handler subscribes with a higher priority than the last one, which rebuilds the list, then unsubscribes a later handler
+		EventType event;
+		onion::EventHandle late;
+		onion::EventHandle added;
+		bool lateCalled = false;
+
+		onion::EventHandle first = event.Subscribe(
+			[&](int)
+			{
+				added = event.Subscribe([](int) {}, 10);
+				event.Unsubscribe(late);
+			},
+			5);
+		late = event.Subscribe([&lateCalled](int) { lateCalled = true; });
+
+		event.Trigger(1);
+		ONION_CHECK(!lateCalled);
+		ONION_CHECK(event.LiveHandlerCount() == 2);
+	}
+
+	template <typename EventType> void ReleasingAHandleAfterRebuildSkipsTheHandler()
+	{
+		EventType event;
+		onion::EventHandle late;
+		std::vector<onion::EventHandle> added;
+		bool lateCalled = false;
+
+		onion::EventHandle first = event.Subscribe(
+			[&](int)
+			{
+				// Enough expired handlers to sweep, then a rebuild, then the release of the later handle
+				for (int index = 0; index < 40; ++index)
+				{
+					added.push_back(event.Subscribe([](int) {}, index));
+				}
+				added.clear();
+				late = onion::EventHandle();
+			},
+			100);
+		late = event.Subscribe([&lateCalled](int) { lateCalled = true; });
+
+		event.Trigger(1);
+		ONION_CHECK(!lateCalled);
+	}
+
+	/// @brief Handler whose copies throw once armed, to make a rebuild of the handlers list fail halfway.
+	struct ThrowingCopyHandler
+	{
+		bool* armed;
+
+		explicit ThrowingCopyHandler(bool* armedFlag) noexcept : armed(armedFlag) {}
+		ThrowingCopyHandler(const ThrowingCopyHandler& other) : armed(other.armed)
+		{
+			if (*armed)
+			{
+				throw std::runtime_error("copy failed");
+			}
+		}
+		ThrowingCopyHandler(ThrowingCopyHandler&& other) noexcept = default;
+
+		void operator()(int) const noexcept {}
+	};
+
+	template <typename EventType> void FailedRebuildKeepsTheSlotsBound()
+	{
+		EventType event;
+		bool armed = false;
+		int calls = 0;
+
+		// The first handler is copied into the rebuilt list before the second one throws
+		onion::EventHandle counted = event.Subscribe([&calls](int) { ++calls; }, 5);
+		onion::EventHandle throwing = event.Subscribe(ThrowingCopyHandler(&armed), 5);
+
+		armed = true;
+		bool threw = false;
+		try
+		{
+			onion::EventHandle rebuilt = event.Subscribe([](int) {}, 10);
+		}
+		catch (const std::runtime_error&)
+		{
+			threw = true;
+		}
+		armed = false;
+		ONION_CHECK(threw);
+
+		// Ending the subscription clears its bit in the list still published, not in the freed one
+		event.Unsubscribe(counted);
+		event.Trigger(1);
+		ONION_CHECK(calls == 0);
+		ONION_CHECK(event.LiveHandlerCount() == 1);
+	}
+
+	/// @brief Coroutine started eagerly, and destroyed with its task.
+	struct Task
+	{
+		struct promise_type
+		{
+			Task get_return_object() noexcept { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_always final_suspend() noexcept { return {}; }
+			void return_void() noexcept {}
+			void unhandled_exception() noexcept { std::abort(); }
+		};
+
+		explicit Task(std::coroutine_handle<promise_type> coroutine) noexcept : handle(coroutine) {}
+		Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+		Task& operator=(Task&&) = delete;
+
+		~Task()
+		{
+			if (handle)
+			{
+				handle.destroy();
+			}
+		}
+
+		std::coroutine_handle<promise_type> handle;
+	};
+
+	template <typename EventType> Task WaitForNext(EventType& event, int& received) { received = co_await event.Next(); }
+
+	/// @brief Waits for the next events until the given number of them was received.
+	Task CollectNext(onion::Event<int>& event, std::vector<int>& received, std::size_t count)
+	{
+		while (received.size() < count)
+		{
+			received.push_back(co_await event.Next());
+		}
+	}
+
+	Task WaitForNextPair(onion::Event<int, std::string>& event, std::optional<std::tuple<int, std::string>>& received)
+	{
+		received = co_await event.Next();
+	}
+
+	template <typename EventType> void AwaitingNextResumesWithTheArgument()
+	{
+		EventType event;
+		int first = 0;
+		int second = 0;
+		Task firstWaiter = WaitForNext(event, first);
+		Task secondWaiter = WaitForNext(event, second);
+		ONION_CHECK(!firstWaiter.handle.done() && !secondWaiter.handle.done());
+
+		event.Trigger(7);
+		ONION_CHECK(first == 7 && second == 7);
+		ONION_CHECK(firstWaiter.handle.done() && secondWaiter.handle.done());
+
+		// Done waiting: later events are not delivered anymore
+		event.Trigger(8);
+		ONION_CHECK(first == 7 && second == 7);
+	}
+
+	void AwaitingNextResumesWithATupleOfTheArguments()
+	{
+		onion::Event<int, std::string> event;
+		std::optional<std::tuple<int, std::string>> received;
+		Task waiter = WaitForNextPair(event, received);
+
+		event.Trigger(3, std::string("three"));
+		ONION_CHECK(waiter.handle.done());
+		ONION_CHECK((received == std::tuple<int, std::string>(3, "three")));
+	}
+
+	void TriggerBatchResumesEachWaiterOnce()
+	{
+		onion::Event<int> event;
+		std::vector<int> once;
+		std::vector<int> looping;
+		Task onceWaiter = CollectNext(event, once, 1);
+		Task loopingWaiter = CollectNext(event, looping, 3);
+
+		// A waiter is resumed by the first element; one waiting again receives the following elements
+		const int elements[] = {1, 2, 3, 4};
+		event.TriggerBatch(elements);
+		ONION_CHECK((once == std::vector<int>{1}));
+		ONION_CHECK((looping == std::vector<int>{1, 2, 3}));
+		ONION_CHECK(onceWaiter.handle.done() && loopingWaiter.handle.done());
+	}
+
+	template <typename EventType> void TriggerAnEventDestroyedByItsHandler(bool batch, bool waiting)
+	{
+		// The handler ends its subscription and destroys the event, so nothing but the trigger keeps the shared state alive
+		EventType* event = new EventType();
+		int received = 0;
+		onion::EventHandle handle;
+		handle = event->Subscribe(
+			[&event, &handle](int)
+			{
+				handle = onion::EventHandle();
+				delete event;
+				event = nullptr;
+			});
+		std::optional<Task> waiter;
+		if (waiting)
+		{
+			waiter.emplace(WaitForNext(*event, received));
+		}
+
+		if (batch)
+		{
+			const int values[] = {1, 2};
+			event->TriggerBatch(values);
+		}
+		else
+		{
+			event->Trigger(1);
+		}
+		ONION_CHECK(event == nullptr);
+
+		// Destroying the event dropped the waiter without resuming it
+		ONION_CHECK(received == 0);
+	}
+
+	template <typename EventType> void DestroyingTheEventFromAHandlerIsSafe()
+	{
+		TriggerAnEventDestroyedByItsHandler<EventType>(false, false);
+		TriggerAnEventDestroyedByItsHandler<EventType>(false, true);
+		TriggerAnEventDestroyedByItsHandler<EventType>(true, false);
+		TriggerAnEventDestroyedByItsHandler<EventType>(true, true);
+	}
+
+	/// @brief Object subscribing its member functions.
+	struct Listener
+	{
+		std::vector<int> received;
+		mutable int peeked = 0;
+
+		void OnValue(int value) { received.push_back(value); }
+		void OnPeek(int) const { ++peeked; }
+	};
+
+	template <typename EventType> void MemberFunctionIsInvokedOnItsObject()
+	{
+		EventType event;
+		Listener first;
+		Listener second;
+		const Listener& observer = second;
+
+		onion::EventHandle firstHandle = event.template Subscribe<&Listener::OnValue>(first);
+		onion::EventHandle secondHandle = event.template Subscribe<&Listener::OnValue>(second, 1);
+		onion::EventHandle peekHandle = event.template Subscribe<&Listener::OnPeek>(observer);
+		ONION_CHECK(event.LiveHandlerCount() == 3);
+
+		event.Trigger(1);
+		event.Trigger(2);
+		ONION_CHECK((first.received == std::vector<int>{1, 2}));
+		ONION_CHECK((second.received == std::vector<int>{1, 2}));
+		ONION_CHECK(second.peeked == 2);
+
+		event.Unsubscribe(firstHandle);
+		event.Trigger(3);
+		ONION_CHECK((first.received == std::vector<int>{1, 2}));
+		ONION_CHECK((second.received == std::vector<int>{1, 2, 3}));
+		ONION_CHECK(second.peeked == 3);
+	}
+
+	template <typename EventType> void ReclamationPolicyDecidesWhenExpiredHandlersAreSwept()
+	{
+		EventType event;
+		int calls = 0;
+		std::vector<onion::EventHandle> handles;
+		for (int handler = 0; handler < 10; ++handler)
+		{
+			handles.push_back(event.Subscribe([&calls](int) { ++calls; }));
+		}
+
+		// Swept once at least four handlers and half of the list expired
+		event.SetReclamationPolicy(onion::ReclamationPolicy{4, 0.5});
+		for (int released = 1; released <= 4; ++released)
+		{
+			handles.pop_back();
+			ONION_CHECK(event.ExpiredHandlerCount() == static_cast<std::size_t>(released));
+			ONION_CHECK(event.LiveHandlerCount() == static_cast<std::size_t>(10 - released));
+		}
+		event.Unsubscribe(handles.back());
+		ONION_CHECK(event.ExpiredHandlerCount() == 0);
+		ONION_CHECK(event.LiveHandlerCount() == 5);
+
+		// Unsubscribing the same handle again, or destroying it, counts nothing more
+		handles.pop_back();
+		ONION_CHECK(event.ExpiredHandlerCount() == 0);
+		ONION_CHECK(event.LiveHandlerCount() == 5);
+
+		// Swept as soon as a handler expires
+		event.SetReclamationPolicy(onion::ReclamationPolicy{1, 0.0});
+		handles.pop_back();
+		ONION_CHECK(event.ExpiredHandlerCount() == 0);
+		ONION_CHECK(event.LiveHandlerCount() == 4);
+
+		// Never swept but on request; expired handlers are skipped meanwhile
+		event.SetReclamationPolicy(onion::ReclamationPolicy{std::numeric_limits<std::size_t>::max(), 1.0});
+		handles.pop_back();
+		handles.pop_back();
+		ONION_CHECK(event.ExpiredHandlerCount() == 2);
+		ONION_CHECK(event.LiveHandlerCount() == 2);
+		event.Trigger(1);
+		ONION_CHECK(calls == 2);
+		event.ClearExpired();
+		ONION_CHECK(event.ExpiredHandlerCount() == 0);
+		ONION_CHECK(event.LiveHandlerCount() == 2);
+	}
+
+	void SweepIsDeferredUntilASingleThreadedTriggerReturns()
+	{
+		onion::SingleThreadedEvent<int> event;
+		event.SetReclamationPolicy(onion::ReclamationPolicy{1, 0.0});
+		std::vector<onion::EventHandle> handles;
+		handles.push_back(event.Subscribe(
+			[&](int)
+			{
+				handles.resize(1);
+				ONION_CHECK(event.ExpiredHandlerCount() == 3);
+			}));
+		for (int handler = 0; handler < 3; ++handler)
+		{
+			handles.push_back(event.Subscribe([](int) {}));
+		}
+
+		// The list the trigger runs from is kept until it returns, then swept
+		event.Trigger(1);
+		ONION_CHECK(event.ExpiredHandlerCount() == 0);
+		ONION_CHECK(event.LiveHandlerCount() == 1);
+	}
+
+	template <typename EventType> void HandlersRunByPriorityThenInSubscriptionOrder()
+	{
+		EventType event;
+		std::vector<int> calls;
+		std::vector<onion::EventHandle> handles;
+		auto subscribe = [&](int id, int priority)
+		{ handles.push_back(event.Subscribe([&calls, id](int) { calls.push_back(id); }, priority)); };
+
+		// Appended at the end, inserted in the middle, before every handler, and among equal priorities
+		subscribe(1, 0);
+		subscribe(2, 0);
+		subscribe(3, 5);
+		subscribe(4, -3);
+		subscribe(5, 5);
+		subscribe(6, 0);
+		subscribe(7, 10);
+		subscribe(8, -3);
+		event.Trigger(0);
+		ONION_CHECK((calls == std::vector<int>{7, 3, 5, 1, 2, 6, 4, 8}));
+
+		// Sweeping keeps the order of the remaining handlers, and later ones still go after their equals
+		event.SetReclamationPolicy(onion::ReclamationPolicy{1, 0.0});
+		handles[1] = onion::EventHandle();
+		handles[2] = onion::EventHandle();
+		subscribe(9, 5);
+		subscribe(10, 0);
+		calls.clear();
+		event.Trigger(0);
+		ONION_CHECK((calls == std::vector<int>{7, 5, 9, 1, 6, 10, 4, 8}));
+	}
+
+	void HandlersSubscribedWhileDispatchingKeepThePriorityOrder()
+	{
+		onion::SingleThreadedEvent<int> event;
+		std::vector<int> calls;
+		std::vector<onion::EventHandle> handles;
+		auto subscribe = [&](int id, int priority)
+		{ handles.push_back(event.Subscribe([&calls, id](int) { calls.push_back(id); }, priority)); };
+
+		subscribe(1, 0);
+		onion::EventHandle subscriber = event.Subscribe(
+			[&](int value)
+			{
+				if (value == 0)
+				{
+					subscribe(2, 0);
+					subscribe(3, 1);
+					subscribe(4, 0);
+				}
+			},
+			2);
+
+		// Deferred until the trigger returns, then listed as if subscribed in that order
+		event.Trigger(0);
+		ONION_CHECK((calls == std::vector<int>{1}));
+		calls.clear();
+		event.Trigger(1);
+		ONION_CHECK((calls == std::vector<int>{3, 1, 2, 4}));
+	}
+
+	void BatchSubscribersOnlyKeepTheirPriorityInHandlerMajorOrder()
+	{
+		onion::Event<int> event;
+		std::vector<int> calls;
+
+		onion::EventHandle batch = event.SubscribeBatch(
+			[&calls](std::span<const int> elements)
+			{
+				for (int element : elements)
+				{
+					calls.push_back(100 + element);
+				}
+			},
+			10);
+		onion::EventHandle single = event.Subscribe([&calls](int element) { calls.push_back(element); });
+
+		const int elements[] = {1, 2};
+		event.TriggerBatch(elements, onion::BatchOrder::HandlerMajor);
+		ONION_CHECK((calls == std::vector<int>{101, 102, 1, 2}));
+
+		// Event by event, batch subscribers run once every other handler received every event
+		calls.clear();
+		event.TriggerBatch(elements, onion::BatchOrder::EventMajor);
+		ONION_CHECK((calls == std::vector<int>{1, 2, 101, 102}));
+	}
+
+	void ConcurrentRebuildsAndUnsubscribesKeepTheListConsistent()
+	{
+		onion::Event<int> event;
+		std::atomic<bool> stop{false};
+		std::atomic<std::size_t> calls{0};
+
+		std::vector<std::thread> triggers;
+		for (int thread = 0; thread < 3; ++thread)
+		{
+			triggers.emplace_back(
+				[&]
+				{
+					while (!stop.load(std::memory_order_relaxed))
+					{
+						event.Trigger(1);
+					}
+				});
+		}
+
+		std::vector<std::thread> writers;
+		std::vector<std::vector<onion::EventHandle>> kept(3);
+		for (int thread = 0; thread < 3; ++thread)
+		{
+			writers.emplace_back(
+				[&, thread]
+				{
+					std::mt19937 random(static_cast<unsigned>(thread));
+					std::vector<onion::EventHandle> handles;
+					for (int round = 0; round < 2000; ++round)
+					{
+						// Random priorities rebuild the list, random releases sweep it
+						handles.push_back(event.Subscribe([&calls](int) { calls.fetch_add(1, std::memory_order_relaxed); },
+														  static_cast<int>(random() % 8)));
+						if (random() % 2 == 0)
+						{
+							const std::size_t index = random() % handles.size();
+							event.Unsubscribe(handles[index]);
+							handles.erase(handles.begin() + static_cast<std::ptrdiff_t>(index));
+						}
+					}
+					kept[static_cast<std::size_t>(thread)] = std::move(handles);
+				});
+		}
+		for (std::thread& writer : writers)
+		{
+			writer.join();
+		}
+		stop.store(true);
+		for (std::thread& trigger : triggers)
+		{
+			trigger.join();
+		}
+
+		std::size_t live = 0;
+		for (const std::vector<onion::EventHandle>& handles : kept)
+		{
+			live += handles.size();
+		}
+		ONION_CHECK(event.LiveHandlerCount() == live);
+
+		calls.store(0);
+		event.Trigger(1);
+		ONION_CHECK(calls.load() == live);
+	}
+} // namespace
+
+int main()
+{
+	ONION_RUN(UnsubscribeAfterRebuildSkipsTheHandler<onion::Event<int>>);
+	ONION_RUN(UnsubscribeAfterRebuildSkipsTheHandler<onion::SpinLockedEvent<int>>);
+	ONION_RUN(UnsubscribeAfterRebuildSkipsTheHandler<onion::SingleThreadedEvent<int>>);
+	ONION_RUN(ReleasingAHandleAfterRebuildSkipsTheHandler<onion::Event<int>>);
+	ONION_RUN(ReleasingAHandleAfterRebuildSkipsTheHandler<onion::SingleThreadedEvent<int>>);
+	ONION_RUN(FailedRebuildKeepsTheSlotsBound<onion::Event<int>>);
+	ONION_RUN(FailedRebuildKeepsTheSlotsBound<onion::SingleThreadedEvent<int>>);
+	ONION_RUN(DestroyingTheEventFromAHandlerIsSafe<onion::Event<int>>);
+	ONION_RUN(DestroyingTheEventFromAHandlerIsSafe<onion::SpinLockedEvent<int>>);
+	ONION_RUN(DestroyingTheEventFromAHandlerIsSafe<onion::SingleThreadedEvent<int>>);
+	ONION_RUN(AwaitingNextResumesWithTheArgument<onion::Event<int>>);
+	ONION_RUN(AwaitingNextResumesWithTheArgument<onion::SingleThreadedEvent<int>>);
+	ONION_RUN(AwaitingNextResumesWithATupleOfTheArguments);
+	ONION_RUN(TriggerBatchResumesEachWaiterOnce);
+	ONION_RUN(MemberFunctionIsInvokedOnItsObject<onion::Event<int>>);
+	ONION_RUN(MemberFunctionIsInvokedOnItsObject<onion::SingleThreadedEvent<int>>);
+	ONION_RUN(ReclamationPolicyDecidesWhenExpiredHandlersAreSwept<onion::Event<int>>);
+	ONION_RUN(ReclamationPolicyDecidesWhenExpiredHandlersAreSwept<onion::SingleThreadedEvent<int>>);
+	ONION_RUN(SweepIsDeferredUntilASingleThreadedTriggerReturns);
+	ONION_RUN(HandlersRunByPriorityThenInSubscriptionOrder<onion::Event<int>>);
+	ONION_RUN(HandlersRunByPriorityThenInSubscriptionOrder<onion::SpinLockedEvent<int>>);
+	ONION_RUN(HandlersRunByPriorityThenInSubscriptionOrder<onion::SingleThreadedEvent<int>>);
+	ONION_RUN(HandlersSubscribedWhileDispatchingKeepThePriorityOrder);
+	ONION_RUN(BatchSubscribersOnlyKeepTheirPriorityInHandlerMajorOrder);
+	ONION_RUN(ConcurrentRebuildsAndUnsubscribesKeepTheListConsistent);
+	return 0;
+}
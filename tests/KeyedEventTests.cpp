@@ -0,0 +1,200 @@
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <onion/KeyedEvent.hpp>
+
+#include "Check.hpp"
+
+namespace
+{
+	template <typename Key, typename... Args>
+	using SingleThreadedKeyedEvent = onion::BasicKeyedEvent<onion::SingleThreaded, onion::DefaultInlineFunctionCapacity, Key, Args...>;
+
+	/// @brief Handler counting its live copies, so tests can tell when the list of a key destroyed it.
+	struct CountedHandler
+	{
+		int* alive;
+		std::vector<int>* calls;
+		int id;
+
+		CountedHandler(int* aliveCount, std::vector<int>* callList, int handlerId) noexcept : alive(aliveCount), calls(callList), id(handlerId)
+		{
+			++*alive;
+		}
+		CountedHandler(const CountedHandler& other) noexcept : alive(other.alive), calls(other.calls), id(other.id) { ++*alive; }
+		CountedHandler& operator=(const CountedHandler&) = delete;
+		~CountedHandler() { --*alive; }
+
+		void operator()(int) const { calls->push_back(id); }
+	};
+
+	template <typename KeyedEvent> void TriggerOnlyInvokesTheHandlersOfTheKey()
+	{
+		KeyedEvent event;
+		int alive = 0;
+		std::vector<int> calls;
+
+		// More handlers than the initial capacity of a key, with priorities forcing rebuilds
+		std::vector<onion::EventHandle> handles;
+		for (int id = 0; id < 10; ++id)
+		{
+			handles.push_back(event.Subscribe(1, CountedHandler(&alive, &calls, id), id % 3));
+		}
+		handles.push_back(event.Subscribe(2, CountedHandler(&alive, &calls, 100)));
+		ONION_CHECK(alive == 11);
+		ONION_CHECK(event.KeyCount() == 2);
+
+		event.Trigger(1, 0);
+		ONION_CHECK((calls == std::vector<int>{2, 5, 8, 1, 4, 7, 0, 3, 6, 9}));
+		ONION_CHECK(event.LiveHandlerCount(1) == 10);
+		ONION_CHECK(event.LiveHandlerCount(2) == 1);
+
+		calls.clear();
+		event.Trigger(3, 0);
+		ONION_CHECK(calls.empty());
+		ONION_CHECK(event.LiveHandlerCount(3) == 0);
+	}
+
+	template <typename KeyedEvent> void UnsubscribeEndsTheSubscriptionOfItsKey()
+	{
+		KeyedEvent event;
+		KeyedEvent other;
+		int alive = 0;
+		std::vector<int> calls;
+
+		onion::EventHandle first = event.Subscribe(1, CountedHandler(&alive, &calls, 1));
+		onion::EventHandle second = event.Subscribe(2, CountedHandler(&alive, &calls, 2));
+
+		// A handle issued by another event is left untouched
+		other.Unsubscribe(second);
+		event.Trigger(2, 0);
+		ONION_CHECK((calls == std::vector<int>{2}));
+
+		event.Unsubscribe(second);
+		event.Unsubscribe(second);
+		event.Trigger(2, 0);
+		event.Trigger(1, 0);
+		ONION_CHECK((calls == std::vector<int>{2, 1}));
+		ONION_CHECK(event.LiveHandlerCount(1) == 1);
+		ONION_CHECK(event.LiveHandlerCount(2) == 0);
+	}
+
+	template <typename KeyedEvent> void ExpiredHandlersOfAKeyAreSwept()
+	{
+		KeyedEvent event;
+		int alive = 0;
+		std::vector<int> calls;
+
+		onion::EventHandle kept = event.Subscribe(1, CountedHandler(&alive, &calls, 0));
+		{
+			std::vector<onion::EventHandle> handles;
+			for (int id = 1; id <= 64; ++id)
+			{
+				handles.push_back(event.Subscribe(1, CountedHandler(&alive, &calls, id)));
+			}
+		}
+
+		// The reclamation policy swept the list of the key once enough of its subscriptions ended
+		ONION_CHECK(alive < 65);
+		ONION_CHECK(event.LiveHandlerCount(1) == 1);
+		event.Trigger(1, 0);
+		ONION_CHECK((calls == std::vector<int>{0}));
+
+		event.Clear();
+		ONION_CHECK(alive == 0);
+		ONION_CHECK(event.KeyCount() == 1);
+		ONION_CHECK(event.LiveHandlerCount(1) == 0);
+	}
+
+	template <typename KeyedEvent> void HandlerMayRebuildTheListItRunsFrom()
+	{
+		KeyedEvent event;
+		std::vector<int> calls;
+		std::vector<onion::EventHandle> added;
+		bool nested = false;
+
+		onion::EventHandle first = event.Subscribe(1,
+												   [&](int)
+												   {
+													   calls.push_back(0);
+													   if (nested)
+													   {
+														   return;
+													   }
+
+													   // Higher priorities rebuild the list the Trigger iterates
+													   for (int priority = 1; priority <= 8; ++priority)
+													   {
+														   added.push_back(event.Subscribe(1, [&calls](int) { calls.push_back(1); }, priority));
+													   }
+													   nested = true;
+													   event.Trigger(1, 0);
+												   });
+		onion::EventHandle last = event.Subscribe(1, [&calls](int) { calls.push_back(2); }, -1);
+
+		event.Trigger(1, 0);
+
+		// The nested Trigger sees the new handlers, the outer one does not
+		ONION_CHECK((calls == std::vector<int>{0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 2, 2}));
+		ONION_CHECK(event.LiveHandlerCount(1) == 2 + 8);
+	}
+
+	template <typename KeyedEvent> void HandlerMayClearTheEvent()
+	{
+		KeyedEvent event;
+		int alive = 0;
+		std::vector<int> calls;
+
+		onion::EventHandle clearing = event.Subscribe(1, [&](int) { event.Clear(); }, 1);
+		onion::EventHandle skipped = event.Subscribe(1, CountedHandler(&alive, &calls, 1));
+
+		event.Trigger(1, 0);
+		ONION_CHECK(calls.empty());
+		ONION_CHECK(event.LiveHandlerCount(1) == 0);
+
+		// Handlers are destroyed once no Trigger can be using them anymore
+		event.Clear();
+		ONION_CHECK(alive == 0);
+	}
+
+	template <typename KeyedEvent> void HandlerMayDestroyTheEvent()
+	{
+		KeyedEvent* event = new KeyedEvent();
+		int alive = 0;
+		std::vector<int> calls;
+		std::unique_ptr<onion::EventHandle> own = std::make_unique<onion::EventHandle>();
+
+		*own = event->Subscribe(1,
+								[&](int)
+								{
+									own.reset();
+									delete event;
+								});
+		onion::EventHandle skipped = event->Subscribe(1, CountedHandler(&alive, &calls, 1));
+
+		event->Trigger(1, 0);
+		ONION_CHECK(calls.empty());
+
+		// The last handle keeps the shared state, and the list, alive
+		skipped = onion::EventHandle();
+		ONION_CHECK(alive == 0);
+	}
+
+	template <typename KeyedEvent> void RunAll()
+	{
+		ONION_RUN(TriggerOnlyInvokesTheHandlersOfTheKey<KeyedEvent>);
+		ONION_RUN(UnsubscribeEndsTheSubscriptionOfItsKey<KeyedEvent>);
+		ONION_RUN(ExpiredHandlersOfAKeyAreSwept<KeyedEvent>);
+		ONION_RUN(HandlerMayRebuildTheListItRunsFrom<KeyedEvent>);
+		ONION_RUN(HandlerMayClearTheEvent<KeyedEvent>);
+		ONION_RUN(HandlerMayDestroyTheEvent<KeyedEvent>);
+	}
+} // namespace
+
+int main()
+{
+	RunAll<onion::KeyedEvent<int, int>>();
+	RunAll<SingleThreadedKeyedEvent<int, int>>();
+	return 0;
+}
@@ -0,0 +1,165 @@
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <onion/Event.hpp>
+#include <onion/Payload.hpp>
+
+#include "Check.hpp"
+
+namespace
+{
+	/// @brief Number of live Snapshot instances.
+	std::atomic<int> liveSnapshots{0};
+
+	/// @brief Number of Snapshot copies.
+	std::atomic<int> copiedSnapshots{0};
+
+	/// @brief Payload value counting its instances and copies, whose construction fails on demand.
+	struct Snapshot
+	{
+		std::vector<int> levels;
+
+		explicit Snapshot(int size, bool fail = false) : levels(static_cast<std::size_t>(size), size)
+		{
+			if (fail)
+			{
+				throw std::runtime_error("snapshot");
+			}
+			++liveSnapshots;
+		}
+		Snapshot(const Snapshot& other) : levels(other.levels)
+		{
+			++liveSnapshots;
+			++copiedSnapshots;
+		}
+		Snapshot& operator=(const Snapshot&) = delete;
+		~Snapshot() { --liveSnapshots; }
+	};
+
+	void StorageIsRecycledThroughThePool()
+	{
+		onion::PayloadPool<Snapshot> pool(1);
+		const Snapshot* first;
+		{
+			onion::Payload<Snapshot> payload = pool.Make(3);
+			first = &*payload;
+			ONION_CHECK(payload->levels.size() == 3);
+			ONION_CHECK(liveSnapshots == 1);
+		}
+		ONION_CHECK(liveSnapshots == 0);
+
+		// The next payload is built in the storage the previous one returned
+		onion::Payload<Snapshot> reused = pool.Make(4);
+		ONION_CHECK(&*reused == first);
+		ONION_CHECK(reused->levels.size() == 4);
+
+		// Copies share the value, which is only destroyed with the last one
+		onion::Payload<Snapshot> copy = reused;
+		ONION_CHECK(&*copy == first);
+		reused = onion::Payload<Snapshot>();
+		ONION_CHECK(!reused);
+		ONION_CHECK(liveSnapshots == 1);
+		copy = onion::Payload<Snapshot>();
+		ONION_CHECK(liveSnapshots == 0);
+		ONION_CHECK(copiedSnapshots == 0);
+
+		// The pool caches a single block: the second one is freed, and the cached one is reused
+		onion::Payload<Snapshot> again = pool.Make(1);
+		onion::Payload<Snapshot> other = pool.Make(2);
+		ONION_CHECK(&*again == first);
+		again = onion::Payload<Snapshot>();
+		other = onion::Payload<Snapshot>();
+		ONION_CHECK(&*pool.Make(5) == first);
+	}
+
+	void PayloadMayOutliveItsPool()
+	{
+		auto pool = std::make_unique<onion::PayloadPool<Snapshot>>();
+		onion::Payload<Snapshot> cached = pool->Make(1);
+		onion::Payload<Snapshot> kept = pool->Make(2);
+		cached = onion::Payload<Snapshot>();
+
+		pool.reset();
+		ONION_CHECK(kept->levels.size() == 2);
+		onion::Payload<Snapshot> copy = kept;
+		kept = onion::Payload<Snapshot>();
+		ONION_CHECK(liveSnapshots == 1);
+
+		// The last payload frees its storage and the state of the destroyed pool
+		copy = onion::Payload<Snapshot>();
+		ONION_CHECK(liveSnapshots == 0);
+	}
+
+	void FailedMakeLeavesThePoolConsistent()
+	{
+		onion::PayloadPool<Snapshot> pool(1);
+		bool thrown = false;
+		try
+		{
+			onion::Payload<Snapshot> failed = pool.Make(3, true);
+		}
+		catch (const std::runtime_error&)
+		{
+			thrown = true;
+		}
+		ONION_CHECK(thrown);
+		ONION_CHECK(liveSnapshots == 0);
+
+		// The storage of the failed payload went back to the pool
+		onion::Payload<Snapshot> payload = pool.Make(2);
+		const Snapshot* storage = &*payload;
+		ONION_CHECK(payload->levels.size() == 2);
+		payload = onion::Payload<Snapshot>();
+		ONION_CHECK(&*pool.Make(4) == storage);
+		ONION_CHECK(liveSnapshots == 0);
+	}
+
+	void EventHandsOneInstanceToEverySubscriber()
+	{
+		onion::PayloadPool<Snapshot> pool;
+		onion::Event<onion::Payload<Snapshot>> event;
+		std::vector<const Snapshot*> received;
+		std::vector<onion::EventHandle> handles;
+		for (int handler = 0; handler < 3; ++handler)
+		{
+			handles.push_back(event.Subscribe([&received](const Snapshot& snapshot) { received.push_back(&snapshot); }));
+		}
+
+		// A handler keeping the payload holds a reference to the value, not a copy
+		onion::Payload<Snapshot> kept;
+		handles.push_back(event.Subscribe([&kept](const onion::Payload<Snapshot>& payload) { kept = payload; }));
+
+		copiedSnapshots = 0;
+		onion::Payload<Snapshot> payload = pool.Make(1000);
+		const Snapshot* instance = &*payload;
+		event.Trigger(payload);
+		ONION_CHECK((received == std::vector<const Snapshot*>{instance, instance, instance}));
+		ONION_CHECK(&*kept == instance);
+		payload = onion::Payload<Snapshot>();
+		ONION_CHECK(liveSnapshots == 1);
+		kept = onion::Payload<Snapshot>();
+		ONION_CHECK(liveSnapshots == 0);
+
+		// The worker receives the same instance, not a copy
+		received.clear();
+		payload = pool.Make(1000);
+		instance = &*payload;
+		onion::Completion completion = event.TriggerAsync(payload);
+		ONION_CHECK(completion);
+		completion.Wait();
+		ONION_CHECK((received == std::vector<const Snapshot*>{instance, instance, instance}));
+		ONION_CHECK(&*kept == instance);
+		ONION_CHECK(copiedSnapshots == 0);
+	}
+} // namespace
+
+int main()
+{
+	ONION_RUN(StorageIsRecycledThroughThePool);
+	ONION_RUN(PayloadMayOutliveItsPool);
+	ONION_RUN(FailedMakeLeavesThePoolConsistent);
+	ONION_RUN(EventHandsOneInstanceToEverySubscriber);
+	return 0;
+}
@@ -0,0 +1,187 @@
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <onion/Dispatcher.hpp>
+#include <onion/Event.hpp>
+#include <onion/MpscQueue.hpp>
+
+#include "Check.hpp"
+
+namespace
+{
+	void PumpDeliversInPostOrder()
+	{
+		onion::SingleThreadedEvent<int> event;
+		std::vector<int> received;
+		onion::EventHandle handle = event.Subscribe([&received](int value) { received.push_back(value); });
+
+		for (int value = 0; value < 100; ++value)
+		{
+			event.Post(value);
+		}
+		ONION_CHECK(received.empty());
+		ONION_CHECK(event.Pump() == 100);
+		for (int value = 0; value < 100; ++value)
+		{
+			ONION_CHECK(received[static_cast<std::size_t>(value)] == value);
+		}
+	}
+
+	void PumpKeepsTheOrderOfEachProducer()
+	{
+		onion::Event<int, int> event;
+		constexpr int Producers = 4;
+		constexpr int PerProducer = 20000;
+		std::vector<int> next(Producers, 0);
+		bool ordered = true;
+		onion::EventHandle handle = event.Subscribe(
+			[&next, &ordered](int producer, int sequence)
+			{
+				ordered = ordered && next[static_cast<std::size_t>(producer)] == sequence;
+				next[static_cast<std::size_t>(producer)] = sequence + 1;
+			});
+
+		std::vector<std::thread> producers;
+		for (int producer = 0; producer < Producers; ++producer)
+		{
+			producers.emplace_back(
+				[&event, producer]
+				{
+					for (int sequence = 0; sequence < PerProducer; ++sequence)
+					{
+						event.Post(producer, sequence);
+					}
+				});
+		}
+
+		// Pump while the producers post, then until every event arrived
+		std::size_t delivered = 0;
+		while (delivered < static_cast<std::size_t>(Producers * PerProducer))
+		{
+			delivered += event.Pump(64);
+		}
+		for (std::thread& producer : producers)
+		{
+			producer.join();
+		}
+
+		ONION_CHECK(ordered);
+		ONION_CHECK(event.Pump() == 0);
+		for (int count : next)
+		{
+			ONION_CHECK(count == PerProducer);
+		}
+	}
+
+	void PumpHonorsItsLimitAndDeliversReposts()
+	{
+		onion::SingleThreadedEvent<int> event;
+		std::vector<int> received;
+		onion::EventHandle handle = event.Subscribe(
+			[&event, &received](int value)
+			{
+				received.push_back(value);
+				if (value == 1)
+				{
+					event.Post(10);
+				}
+			});
+
+		event.Post(1);
+		event.Post(2);
+		event.Post(3);
+		ONION_CHECK(event.Pump(2) == 2);
+		ONION_CHECK((received == std::vector<int>{1, 2}));
+
+		// The event posted by the handler is queued behind the ones posted before
+		ONION_CHECK(event.Pump() == 2);
+		ONION_CHECK((received == std::vector<int>{1, 2, 3, 10}));
+	}
+
+	void DestroyingTheEventDropsPostedEvents()
+	{
+		std::shared_ptr<int> payload = std::make_shared<int>(7);
+		{
+			onion::Event<std::shared_ptr<int>> event;
+			event.Post(payload);
+			event.Post(payload);
+			ONION_CHECK(payload.use_count() == 3);
+		}
+		ONION_CHECK(payload.use_count() == 1);
+	}
+
+	void MpscQueuePopsInPushOrder()
+	{
+		onion::detail::MpscQueue<std::unique_ptr<int>> queue;
+		ONION_CHECK(!queue.TryPop());
+		for (int value = 0; value < 10; ++value)
+		{
+			queue.Push(std::make_unique<int>(value));
+		}
+		for (int value = 0; value < 10; ++value)
+		{
+			std::optional<std::unique_ptr<int>> popped = queue.TryPop();
+			ONION_CHECK(popped && **popped == value);
+		}
+		ONION_CHECK(!queue.TryPop());
+
+		// Values still queued are destroyed with the queue
+		queue.Push(std::make_unique<int>(42));
+	}
+
+	void DispatcherRunsAffineHandlersOnItsThreadInOrder()
+	{
+		onion::Dispatcher dispatcher;
+		onion::Event<int> event;
+		const std::thread::id owner = std::this_thread::get_id();
+		std::vector<int> received;
+		bool onOwner = true;
+		onion::EventHandle handle = event.Subscribe(dispatcher,
+													[&](int value)
+													{
+														onOwner = onOwner && std::this_thread::get_id() == owner;
+														received.push_back(value);
+													});
+
+		event.Trigger(0);
+		std::thread other(
+			[&event]
+			{
+				for (int value = 1; value <= 100; ++value)
+				{
+					event.Trigger(value);
+				}
+			});
+		other.join();
+
+		ONION_CHECK(received.size() == 1);
+		ONION_CHECK(dispatcher.Pump() == 100);
+		ONION_CHECK(onOwner);
+		for (int value = 0; value <= 100; ++value)
+		{
+			ONION_CHECK(received[static_cast<std::size_t>(value)] == value);
+		}
+
+		// Events queued for an ended subscription are dropped
+		std::thread late([&event] { event.Trigger(1000); });
+		late.join();
+		handle = onion::EventHandle();
+		ONION_CHECK(dispatcher.Pump() == 1);
+		ONION_CHECK(received.size() == 101);
+	}
+} // namespace
+
+int main()
+{
+	ONION_RUN(PumpDeliversInPostOrder);
+	ONION_RUN(PumpKeepsTheOrderOfEachProducer);
+	ONION_RUN(PumpHonorsItsLimitAndDeliversReposts);
+	ONION_RUN(DestroyingTheEventDropsPostedEvents);
+	ONION_RUN(MpscQueuePopsInPushOrder);
+	ONION_RUN(DispatcherRunsAffineHandlersOnItsThreadInOrder);
+	return 0;
+}
@@ -0,0 +1,213 @@
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <onion/ReplayEvent.hpp>
+
+#include "Check.hpp"
+
+namespace
+{
+	template <typename ThreadingPolicy, std::size_t ReplayCount>
+	using Replay = onion::BasicReplayEvent<ThreadingPolicy, onion::DefaultInlineFunctionCapacity, ReplayCount, int>;
+
+	template <typename ThreadingPolicy> void SubscriberReceivesTheRememberedEventsOldestFirst()
+	{
+		Replay<ThreadingPolicy, 4> event;
+		std::vector<int> empty;
+		onion::EventHandle first = event.Subscribe([&empty](int value) { empty.push_back(value); });
+		ONION_CHECK(empty.empty());
+		ONION_CHECK(event.ReplaySize() == 0);
+
+		// Fewer events than the ring holds
+		event.Trigger(1);
+		event.Trigger(2);
+		ONION_CHECK(event.ReplaySize() == 2);
+		std::vector<int> partial;
+		onion::EventHandle second = event.Subscribe([&partial](int value) { partial.push_back(value); });
+		ONION_CHECK((partial == std::vector<int>{1, 2}));
+
+		// The ring wrapped: only the last four events are replayed, oldest first
+		for (int value = 3; value <= 7; ++value)
+		{
+			event.Trigger(value);
+		}
+		ONION_CHECK(event.ReplaySize() == 4);
+		std::vector<int> wrapped;
+		onion::EventHandle third = event.Subscribe([&wrapped](int value) { wrapped.push_back(value); });
+		ONION_CHECK((wrapped == std::vector<int>{4, 5, 6, 7}));
+
+		// Then each subscriber receives the live events once
+		event.Trigger(8);
+		ONION_CHECK((empty == std::vector<int>{1, 2, 3, 4, 5, 6, 7, 8}));
+		ONION_CHECK((partial == std::vector<int>{1, 2, 3, 4, 5, 6, 7, 8}));
+		ONION_CHECK((wrapped == std::vector<int>{4, 5, 6, 7, 8}));
+	}
+
+	void SubscribingWhileTriggeringNeverDuplicatesNorSkips()
+	{
+		constexpr int TriggerCount = 20000;
+		constexpr int SubscriberCount = 50;
+
+		onion::ReplayEvent<8, int> event;
+		std::atomic<bool> started{false};
+		std::thread trigger(
+			[&]
+			{
+				for (int value = 0; value < TriggerCount; ++value)
+				{
+					event.Trigger(value);
+					started.store(true, std::memory_order_release);
+				}
+			});
+		while (!started.load(std::memory_order_acquire))
+		{
+			std::this_thread::yield();
+		}
+
+		// Each subscriber must see consecutive values from its first one on, whichever were replayed or live
+		std::vector<std::unique_ptr<std::vector<int>>> received;
+		std::vector<onion::EventHandle> handles;
+		for (int subscriber = 0; subscriber < SubscriberCount; ++subscriber)
+		{
+			received.push_back(std::make_unique<std::vector<int>>());
+			std::vector<int>* values = received.back().get();
+			handles.push_back(event.Subscribe([values](int value) { values->push_back(value); }));
+			std::this_thread::yield();
+		}
+		trigger.join();
+
+		for (const std::unique_ptr<std::vector<int>>& values : received)
+		{
+			ONION_CHECK(!values->empty());
+			ONION_CHECK(values->back() == TriggerCount - 1);
+			for (std::size_t i = 1; i < values->size(); ++i)
+			{
+				ONION_CHECK((*values)[i] == (*values)[i - 1] + 1);
+			}
+		}
+	}
+
+	void HandlerSubscribedByAHandlerReceivesTheNestedTriggers()
+	{
+		Replay<onion::SingleThreaded, 4> event;
+		std::vector<int> late;
+		std::optional<onion::EventHandle> lateHandle;
+		onion::EventHandle handle = event.Subscribe(
+			[&](int value)
+			{
+				if (value == 1)
+				{
+					// Replayed 1 now, but only live once the outer Trigger returns
+					lateHandle.emplace(event.Subscribe([&late](int received) { late.push_back(received); }));
+					event.Trigger(2);
+				}
+			});
+
+		event.Trigger(1);
+		ONION_CHECK((late == std::vector<int>{1}));
+
+		// 2 was triggered before the subscription took effect, and is replayed right before the next event
+		event.Trigger(3);
+		ONION_CHECK((late == std::vector<int>{1, 2, 3}));
+		event.Trigger(4);
+		ONION_CHECK((late == std::vector<int>{1, 2, 3, 4}));
+	}
+
+	void LateHandlerMissesTheNestedTriggersOverwrittenSince()
+	{
+		Replay<onion::SingleThreaded, 4> event;
+		std::vector<int> late;
+		std::optional<onion::EventHandle> lateHandle;
+		onion::EventHandle handle = event.Subscribe(
+			[&](int value)
+			{
+				if (value == 1)
+				{
+					lateHandle.emplace(event.Subscribe([&late](int received) { late.push_back(received); }));
+					for (int nested = 2; nested <= 7; ++nested)
+					{
+						event.Trigger(nested);
+					}
+				}
+			});
+
+		// Once 8 is recorded, the ring only holds 5 to 8
+		event.Trigger(1);
+		event.Trigger(8);
+		ONION_CHECK((late == std::vector<int>{1, 5, 6, 7, 8}));
+	}
+
+	void NestedTriggerReachingALateHandlerFirstIsNotDuplicated()
+	{
+		Replay<onion::SingleThreaded, 8> event;
+		std::vector<int> late;
+		std::optional<onion::EventHandle> lateHandle;
+
+		// Invoked before the late handler, and triggers 4 from 3, so the late handler receives 4 before the outer 3
+		onion::EventHandle handle = event.Subscribe(
+			[&](int value)
+			{
+				if (value == 1)
+				{
+					lateHandle.emplace(event.Subscribe([&late](int received) { late.push_back(received); }));
+					event.Trigger(2);
+				}
+				else if (value == 3)
+				{
+					event.Trigger(4);
+				}
+			},
+			1);
+
+		event.Trigger(1);
+		event.Trigger(3);
+		ONION_CHECK((late == std::vector<int>{1, 2, 3, 4}));
+	}
+
+	void LateHandlerMayDestroyTheEventWhileCatchingUp()
+	{
+		auto event = std::make_unique<Replay<onion::SingleThreaded, 4>>();
+		std::vector<int> late;
+		std::optional<onion::EventHandle> lateHandle;
+		onion::EventHandle handle = event->Subscribe(
+			[&](int value)
+			{
+				if (value == 1)
+				{
+					lateHandle.emplace(event->Subscribe(
+						[&](int received)
+						{
+							late.push_back(received);
+							if (received == 2)
+							{
+								event.reset();
+							}
+						}));
+					event->Trigger(2);
+				}
+			});
+
+		event->Trigger(1);
+		event->Trigger(3);
+
+		// Destroying the event while 2 was replayed ended the subscription before 3 was delivered
+		ONION_CHECK(!event);
+		ONION_CHECK((late == std::vector<int>{1, 2}));
+	}
+} // namespace
+
+int main()
+{
+	ONION_RUN(SubscriberReceivesTheRememberedEventsOldestFirst<onion::MultiThreaded>);
+	ONION_RUN(SubscriberReceivesTheRememberedEventsOldestFirst<onion::SingleThreaded>);
+	ONION_RUN(SubscribingWhileTriggeringNeverDuplicatesNorSkips);
+	ONION_RUN(HandlerSubscribedByAHandlerReceivesTheNestedTriggers);
+	ONION_RUN(LateHandlerMissesTheNestedTriggersOverwrittenSince);
+	ONION_RUN(NestedTriggerReachingALateHandlerFirstIsNotDuplicated);
+	ONION_RUN(LateHandlerMayDestroyTheEventWhileCatchingUp);
+	return 0;
+}
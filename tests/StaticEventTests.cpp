@@ -0,0 +1,70 @@
+#include <optional>
+
+#include <onion/StaticEvent.hpp>
+
+#include "Check.hpp"
+
+namespace
+{
+	void UnsubscribedHandlerIsSkippedByTheRunningTrigger()
+	{
+		onion::StaticEvent<4, int> event;
+		onion::EventHandle late;
+		bool lateCalled = false;
+
+		onion::EventHandle first = event.Subscribe([&](int) { event.Unsubscribe(late); });
+		late = event.Subscribe([&lateCalled](int) { lateCalled = true; });
+
+		event.Trigger(1);
+		ONION_CHECK(!lateCalled);
+		ONION_CHECK(event.LiveHandlerCount() == 1);
+	}
+
+	void FullEventReturnsAnEmptyHandle()
+	{
+		onion::StaticEvent<2, int> event;
+		onion::EventHandle first = event.Subscribe([](int) {});
+		onion::EventHandle second = event.Subscribe([](int) {});
+		ONION_CHECK(first && second);
+		ONION_CHECK(!event.Subscribe([](int) {}));
+
+		// Releasing a handle frees its entry once no Trigger is running
+		second = onion::EventHandle();
+		ONION_CHECK(event.Subscribe([](int) {}));
+	}
+
+	/// @brief Object holding an event and the handles of its own handlers, declared after it so they are released first.
+	template <typename ThreadingPolicy> struct Subscriber
+	{
+		onion::BasicStaticEvent<ThreadingPolicy, onion::DefaultInlineFunctionCapacity, 2, int> event;
+		onion::EventHandle first;
+		onion::EventHandle second;
+		int calls = 0;
+
+		Subscriber()
+		{
+			first = event.Subscribe([this](int) { ++calls; });
+			second = event.Subscribe([this](int) { ++calls; });
+		}
+	};
+
+	template <typename ThreadingPolicy> void HandlesDeclaredAfterTheEventAreReleasedFirst()
+	{
+		std::optional<Subscriber<ThreadingPolicy>> subscriber;
+		subscriber.emplace();
+		subscriber->event.Trigger(1);
+		ONION_CHECK(subscriber->calls == 2);
+
+		// The handles end their subscriptions in the event, which is destroyed last
+		subscriber.reset();
+	}
+} // namespace
+
+int main()
+{
+	ONION_RUN(UnsubscribedHandlerIsSkippedByTheRunningTrigger);
+	ONION_RUN(FullEventReturnsAnEmptyHandle);
+	ONION_RUN(HandlesDeclaredAfterTheEventAreReleasedFirst<onion::MultiThreaded>);
+	ONION_RUN(HandlesDeclaredAfterTheEventAreReleasedFirst<onion::SingleThreaded>);
+	return 0;
+}
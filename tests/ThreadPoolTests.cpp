@@ -0,0 +1,252 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <onion/Event.hpp>
+#include <onion/ThreadPool.hpp>
+
+#include "Check.hpp"
+
+namespace
+{
+	void ParallelForVisitsEveryIndexOnce()
+	{
+		onion::ThreadPool pool(4);
+		constexpr std::size_t Count = 100000;
+		std::unique_ptr<std::atomic<int>[]> visits = std::make_unique<std::atomic<int>[]>(Count);
+
+		pool.ParallelFor(Count, 1,
+						 [&visits](std::size_t begin, std::size_t end)
+						 {
+							 for (std::size_t index = begin; index < end; ++index)
+							 {
+								 visits[index].fetch_add(1, std::memory_order_relaxed);
+							 }
+						 });
+
+		for (std::size_t index = 0; index < Count; ++index)
+		{
+			ONION_CHECK(visits[index].load() == 1);
+		}
+	}
+
+	void IdleParticipantsStealFromABusyOne()
+	{
+		// The caller owns the first quarter of the range, which is the only slow part: the helpers must steal from it
+		onion::ThreadPool pool(3);
+		constexpr std::size_t Count = 1024;
+		const std::thread::id caller = std::this_thread::get_id();
+		std::unique_ptr<std::thread::id[]> runners = std::make_unique<std::thread::id[]>(Count);
+
+		pool.ParallelFor(Count, 1,
+						 [&runners](std::size_t begin, std::size_t end)
+						 {
+							 for (std::size_t index = begin; index < end; ++index)
+							 {
+								 if (index < Count / 4)
+								 {
+									 std::this_thread::sleep_for(std::chrono::microseconds(200));
+								 }
+								 runners[index] = std::this_thread::get_id();
+							 }
+						 });
+
+		std::size_t stolen = 0;
+		for (std::size_t index = 0; index < Count / 4; ++index)
+		{
+			stolen += runners[index] != caller ? 1 : 0;
+		}
+		ONION_CHECK(stolen > 0);
+	}
+
+	void ConcurrentParallelForsShareThePool()
+	{
+		onion::ThreadPool pool(4, 16);
+		constexpr std::size_t Callers = 8;
+		constexpr std::size_t Rounds = 200;
+		constexpr std::size_t Count = 997;
+		std::atomic<std::size_t> failures{0};
+
+		std::vector<std::thread> callers;
+		for (std::size_t caller = 0; caller < Callers; ++caller)
+		{
+			callers.emplace_back(
+				[&]
+				{
+					std::vector<std::atomic<int>> visits(Count);
+					for (std::size_t round = 0; round < Rounds; ++round)
+					{
+						for (std::atomic<int>& visit : visits)
+						{
+							visit.store(0, std::memory_order_relaxed);
+						}
+						pool.ParallelFor(Count, 3,
+										 [&visits](std::size_t begin, std::size_t end)
+										 {
+											 for (std::size_t index = begin; index < end; ++index)
+											 {
+												 visits[index].fetch_add(1, std::memory_order_relaxed);
+											 }
+										 });
+						for (const std::atomic<int>& visit : visits)
+						{
+							if (visit.load(std::memory_order_relaxed) != 1)
+							{
+								failures.fetch_add(1, std::memory_order_relaxed);
+							}
+						}
+					}
+				});
+		}
+		for (std::thread& thread : callers)
+		{
+			thread.join();
+		}
+		ONION_CHECK(failures.load() == 0);
+	}
+
+	void ParallelForRethrowsAfterRunningEveryChunk()
+	{
+		onion::ThreadPool pool(4);
+		constexpr std::size_t Count = 4096;
+		std::atomic<std::size_t> processed{0};
+		bool thrown = false;
+		try
+		{
+			pool.ParallelFor(Count, 16,
+							 [&processed](std::size_t begin, std::size_t end)
+							 {
+								 processed.fetch_add(end - begin, std::memory_order_relaxed);
+								 if (begin == 0)
+								 {
+									 throw std::runtime_error("chunk failed");
+								 }
+							 });
+		}
+		catch (const std::runtime_error&)
+		{
+			thrown = true;
+		}
+		ONION_CHECK(thrown);
+		ONION_CHECK(processed.load() == Count);
+	}
+
+	void TryPostRejectsWhenTheQueueIsFull()
+	{
+		onion::ThreadPool pool(1, 1);
+		std::atomic<bool> release{false};
+		std::atomic<bool> started{false};
+		struct Blocker
+		{
+			std::atomic<bool>* started;
+			std::atomic<bool>* release;
+		} blocker{&started, &release};
+
+		const auto block = [](void* context) noexcept
+		{
+			Blocker* state = static_cast<Blocker*>(context);
+			state->started->store(true);
+			while (!state->release->load())
+			{
+				std::this_thread::yield();
+			}
+		};
+		const auto nothing = [](void*) noexcept {};
+
+		ONION_CHECK(pool.TryPost(onion::ThreadPool::Task{block, &blocker}));
+		while (!started.load())
+		{
+			std::this_thread::yield();
+		}
+		ONION_CHECK(pool.TryPost(onion::ThreadPool::Task{nothing, nullptr}));
+		ONION_CHECK(!pool.TryPost(onion::ThreadPool::Task{nothing, nullptr}));
+		release.store(true);
+	}
+
+	void TriggerParallelInvokesEveryHandlerOnce()
+	{
+		onion::ThreadPool pool(4);
+		onion::Event<int> event;
+		event.SetThreadPool(pool);
+		event.SetParallelGrain(4);
+
+		constexpr std::size_t HandlerCount = 500;
+		std::vector<std::atomic<int>> calls(HandlerCount);
+		std::vector<onion::EventHandle> handles;
+		for (std::size_t index = 0; index < HandlerCount; ++index)
+		{
+			handles.push_back(event.Subscribe([&calls, index](int value) { calls[index].fetch_add(value); }));
+		}
+
+		std::vector<std::thread> triggers;
+		for (int thread = 0; thread < 4; ++thread)
+		{
+			triggers.emplace_back(
+				[&event]
+				{
+					for (int round = 0; round < 50; ++round)
+					{
+						event.TriggerParallel(1);
+					}
+				});
+		}
+		for (std::thread& thread : triggers)
+		{
+			thread.join();
+		}
+		for (const std::atomic<int>& count : calls)
+		{
+			ONION_CHECK(count.load() == 4 * 50);
+		}
+	}
+
+	void TriggerAsyncCompletesAndReportsExceptions()
+	{
+		onion::ThreadPool pool(2);
+		onion::Event<int> event;
+		event.SetThreadPool(pool);
+
+		std::atomic<int> sum{0};
+		onion::EventHandle handle = event.Subscribe(
+			[&sum](int value)
+			{
+				if (value < 0)
+				{
+					throw std::runtime_error("negative");
+				}
+				sum.fetch_add(value);
+			});
+
+		onion::Completion completion = event.TriggerAsync(5);
+		ONION_CHECK(completion);
+		completion.Wait();
+		ONION_CHECK(sum.load() == 5);
+
+		bool thrown = false;
+		try
+		{
+			event.TriggerAsync(-1).Wait();
+		}
+		catch (const std::runtime_error&)
+		{
+			thrown = true;
+		}
+		ONION_CHECK(thrown);
+	}
+} // namespace
+
+int main()
+{
+	ONION_RUN(ParallelForVisitsEveryIndexOnce);
+	ONION_RUN(IdleParticipantsStealFromABusyOne);
+	ONION_RUN(ConcurrentParallelForsShareThePool);
+	ONION_RUN(ParallelForRethrowsAfterRunningEveryChunk);
+	ONION_RUN(TryPostRejectsWhenTheQueueIsFull);
+	ONION_RUN(TriggerParallelInvokesEveryHandlerOnce);
+	ONION_RUN(TriggerAsyncCompletesAndReportsExceptions);
+	return 0;
+}
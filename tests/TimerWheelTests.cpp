@@ -0,0 +1,285 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <onion/Event.hpp>
+#include <onion/TimerWheel.hpp>
+
+#include "Check.hpp"
+
+namespace
+{
+	using Clock = onion::TimerWheel::Clock;
+
+	constexpr Clock::duration Resolution = std::chrono::seconds(1);
+
+	/// @brief Number of ticks covered by the four levels of a wheel.
+	constexpr std::uint64_t WheelRange = std::uint64_t{1} << 24;
+
+	/// @brief Timer recording the ticks at which it expires.
+	struct RecordingTimer : onion::detail::TimerNode
+	{
+		std::vector<std::uint64_t> expired;
+		bool cancelled = false;
+
+		RecordingTimer() { expire = &Record; }
+
+		static void Record(onion::detail::TimerNode& node, bool fired) noexcept
+		{
+			RecordingTimer& timer = static_cast<RecordingTimer&>(node);
+			if (fired)
+			{
+				timer.expired.push_back(timer.deadline);
+			}
+			else
+			{
+				timer.cancelled = true;
+			}
+		}
+	};
+
+	/// @brief Returns a time inside the given tick of a wheel created right after start.
+	Clock::time_point At(Clock::time_point start, std::uint64_t tick)
+	{
+		return start + static_cast<Clock::rep>(tick) * Resolution + Resolution / 2;
+	}
+
+	void TimersCascadeDownToTheirDeadlineTick()
+	{
+		const Clock::time_point start = Clock::now();
+		onion::TimerWheel wheel(Resolution);
+
+		// Deadlines on each side of the boundaries of every level
+		const std::vector<std::uint64_t> deadlines = {1,		 63,		64,		   65,		  4095,				4096,
+													  4097,		 262143,	262144,	   262145,	  3 * 262144 + 4097, WheelRange - 1};
+		std::vector<RecordingTimer> timers(deadlines.size());
+		for (std::size_t i = 0; i < deadlines.size(); ++i)
+		{
+			wheel.Schedule(timers[i], deadlines[i]);
+		}
+
+		for (std::size_t i = 0; i < deadlines.size(); ++i)
+		{
+			wheel.AdvanceTo(At(start, deadlines[i] - 1));
+			ONION_CHECK(timers[i].expired.empty());
+			ONION_CHECK(wheel.AdvanceTo(At(start, deadlines[i])) == 1);
+			ONION_CHECK((timers[i].expired == std::vector<std::uint64_t>{deadlines[i]}));
+		}
+	}
+
+	void TimersBeyondTheRangeAreParkedUntilTheirDeadline()
+	{
+		const Clock::time_point start = Clock::now();
+		onion::TimerWheel wheel(Resolution);
+
+		RecordingTimer next;
+		RecordingTimer later;
+		wheel.Schedule(next, WheelRange + 100);
+		wheel.Schedule(later, 2 * WheelRange + 5);
+
+		// Parked timers go round the last level without expiring early
+		ONION_CHECK(wheel.AdvanceTo(At(start, WheelRange + 99)) == 0);
+		ONION_CHECK(wheel.AdvanceTo(At(start, WheelRange + 100)) == 1);
+		ONION_CHECK((next.expired == std::vector<std::uint64_t>{WheelRange + 100}));
+
+		ONION_CHECK(wheel.AdvanceTo(At(start, 2 * WheelRange + 4)) == 0);
+		ONION_CHECK(wheel.AdvanceTo(At(start, 2 * WheelRange + 5)) == 1);
+		ONION_CHECK((later.expired == std::vector<std::uint64_t>{2 * WheelRange + 5}));
+	}
+
+	void DestroyedWheelHandsTimersBack()
+	{
+		RecordingTimer timer;
+		{
+			onion::TimerWheel wheel(Resolution);
+			wheel.Schedule(timer, 10);
+		}
+		ONION_CHECK(timer.expired.empty());
+		ONION_CHECK(timer.cancelled);
+	}
+
+	void ThrottledHandlerNeverOverlapsItself()
+	{
+		onion::TimerWheel wheel(std::chrono::milliseconds(1));
+		onion::Event<int> event;
+		std::atomic<int> inside{0};
+		std::atomic<bool> entered{false};
+		std::atomic<bool> release{false};
+		std::vector<int> received;
+
+		onion::EventHandle handle = event.Subscribe(
+			[&](int value)
+			{
+				ONION_CHECK(inside.fetch_add(1) == 0);
+				if (value == 1)
+				{
+					entered.store(true);
+					while (!release.load())
+					{
+						std::this_thread::yield();
+					}
+				}
+				received.push_back(value);
+				inside.fetch_sub(1);
+			},
+			onion::Throttle{std::chrono::milliseconds(10), &wheel});
+
+		std::thread first([&] { event.Trigger(1); });
+		while (!entered.load())
+		{
+			std::this_thread::yield();
+		}
+
+		// Kept for the end of the interval, which is not timed before the immediate call returns
+		event.Trigger(2);
+		ONION_CHECK(wheel.AdvanceTo(Clock::now() + std::chrono::seconds(1)) == 0);
+
+		release.store(true);
+		first.join();
+		ONION_CHECK(wheel.AdvanceTo(Clock::now() + std::chrono::seconds(2)) == 1);
+		ONION_CHECK((received == std::vector<int>{1, 2}));
+	}
+
+	void DebouncedHandlerReceivesTheLatestEventOnceQuiet()
+	{
+		const Clock::time_point start = Clock::now();
+		onion::TimerWheel wheel(Resolution);
+		onion::Event<int> event;
+		std::vector<int> received;
+		onion::EventHandle handle =
+			event.Subscribe([&received](int value) { received.push_back(value); }, onion::Debounce{10 * Resolution, &wheel});
+
+		event.Trigger(1);
+		event.Trigger(2);
+		wheel.AdvanceTo(At(start, 5));
+		ONION_CHECK(received.empty());
+
+		// Triggering again restarts the quiet time, so the first deadline passes without delivering
+		event.Trigger(3);
+		wheel.AdvanceTo(At(start, 12));
+		ONION_CHECK(received.empty());
+		wheel.AdvanceTo(At(start, 14));
+		ONION_CHECK(received.empty());
+		wheel.AdvanceTo(At(start, 15));
+		ONION_CHECK((received == std::vector<int>{3}));
+
+		// Nothing is delivered while the event stays quiet, and the next event waits for its own quiet time
+		wheel.AdvanceTo(At(start, 40));
+		event.Trigger(4);
+		wheel.AdvanceTo(At(start, 49));
+		ONION_CHECK((received == std::vector<int>{3}));
+		wheel.AdvanceTo(At(start, 50));
+		ONION_CHECK((received == std::vector<int>{3, 4}));
+	}
+
+	/// @brief Number of exceptions received by RecordError.
+	int recordedErrors = 0;
+
+	void RecordError(std::exception_ptr error) noexcept
+	{
+		try
+		{
+			std::rethrow_exception(error);
+		}
+		catch (const std::runtime_error&)
+		{
+			++recordedErrors;
+		}
+		catch (...)
+		{
+		}
+	}
+
+	void DelayedExceptionsGoToTheErrorSink()
+	{
+		const Clock::time_point start = Clock::now();
+		onion::TimerWheel wheel(Resolution);
+		onion::Event<int> event;
+		auto failing = [](int value)
+		{
+			if (value % 2 == 0)
+			{
+				throw std::runtime_error("even");
+			}
+		};
+		onion::EventHandle throttled = event.Subscribe(failing, onion::Throttle{10 * Resolution, &wheel, &RecordError});
+		onion::EventHandle debounced = event.Subscribe(failing, onion::Debounce{10 * Resolution, &wheel, &RecordError});
+		onion::EventHandle ignored = event.Subscribe(failing, onion::Debounce{10 * Resolution, &wheel});
+
+		recordedErrors = 0;
+		event.Trigger(1);
+		event.Trigger(2);
+		wheel.AdvanceTo(At(start, 10));
+		ONION_CHECK(recordedErrors == 2);
+
+		// The interval following the delayed call ends without any event
+		wheel.AdvanceTo(At(start, 20));
+
+		// The immediate call of a throttled handler throws to the trigger, not to the sink
+		bool thrown = false;
+		try
+		{
+			event.Trigger(4);
+		}
+		catch (const std::runtime_error&)
+		{
+			thrown = true;
+		}
+		ONION_CHECK(thrown);
+		ONION_CHECK(recordedErrors == 2);
+	}
+
+	void SingleThreadedEventNeedsAManualWheel()
+	{
+		onion::SingleThreadedEvent<int> event;
+		std::vector<int> received;
+		auto handler = [&received](int value) { received.push_back(value); };
+
+		bool rejected = false;
+		try
+		{
+			onion::EventHandle shared = event.Subscribe(handler, onion::Debounce{std::chrono::milliseconds(10)});
+		}
+		catch (const std::invalid_argument&)
+		{
+			rejected = true;
+		}
+		ONION_CHECK(rejected);
+
+		rejected = false;
+		onion::TimerWheel threaded(std::chrono::milliseconds(1), onion::TimerWheel::Driver::OwnThread);
+		try
+		{
+			onion::EventHandle owned = event.Subscribe(handler, onion::Throttle{std::chrono::milliseconds(10), &threaded});
+		}
+		catch (const std::invalid_argument&)
+		{
+			rejected = true;
+		}
+		ONION_CHECK(rejected);
+
+		onion::TimerWheel wheel(std::chrono::milliseconds(1));
+		onion::EventHandle handle = event.Subscribe(handler, onion::Throttle{std::chrono::milliseconds(10), &wheel});
+		event.Trigger(1);
+		event.Trigger(2);
+		event.Trigger(3);
+		ONION_CHECK(wheel.AdvanceTo(Clock::now() + std::chrono::seconds(1)) == 1);
+		ONION_CHECK((received == std::vector<int>{1, 3}));
+	}
+} // namespace
+
+int main()
+{
+	ONION_RUN(TimersCascadeDownToTheirDeadlineTick);
+	ONION_RUN(TimersBeyondTheRangeAreParkedUntilTheirDeadline);
+	ONION_RUN(DestroyedWheelHandsTimersBack);
+	ONION_RUN(ThrottledHandlerNeverOverlapsItself);
+	ONION_RUN(DebouncedHandlerReceivesTheLatestEventOnceQuiet);
+	ONION_RUN(DelayedExceptionsGoToTheErrorSink);
+	ONION_RUN(SingleThreadedEventNeedsAManualWheel);
+	return 0;
+}